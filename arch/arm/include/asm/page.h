@@ -202,6 +202,7 @@ extern int pfn_valid(unsigned long);
 #endif
 
 extern phys_addr_t lowmem_limit;
+extern void *vmalloc_min;
 
 #include <asm/memory.h>
 
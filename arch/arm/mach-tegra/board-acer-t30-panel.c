@@ -580,6 +580,7 @@ int __init acer_panel_init(void)
 
 	acer_carveouts[1].base = tegra_carveout_start;
 	acer_carveouts[1].size = tegra_carveout_size;
+	acer_carveouts[1].movable = tegra_carveout_movable;
 
 	tegra_gpio_enable(LVDS_SHUTDOWN);
 	tegra_gpio_enable(LCD_VDD);
@@ -67,6 +67,7 @@ extern unsigned long tegra_fb2_start;
 extern unsigned long tegra_fb2_size;
 extern unsigned long tegra_carveout_start;
 extern unsigned long tegra_carveout_size;
+extern bool tegra_carveout_movable;
 extern unsigned long tegra_vpr_start;
 extern unsigned long tegra_vpr_size;
 extern unsigned long tegra_lp0_vec_start;
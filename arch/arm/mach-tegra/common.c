@@ -28,6 +28,8 @@
 #include <linux/memblock.h>
 #include <linux/bitops.h>
 #include <linux/sched.h>
+#include <linux/gfp.h>
+#include <linux/mmzone.h>
 
 #include <asm/hardware/cache-l2x0.h>
 #include <asm/system.h>
@@ -87,6 +89,7 @@ unsigned long tegra_fb2_start;
 unsigned long tegra_fb2_size;
 unsigned long tegra_carveout_start;
 unsigned long tegra_carveout_size;
+bool tegra_carveout_movable;
 unsigned long tegra_vpr_start;
 unsigned long tegra_vpr_size;
 unsigned long tegra_lp0_vec_start;
@@ -829,6 +832,65 @@ out:
 #define SUPPORT_SMMU_BASE_FOR_TEGRA3_A01
 #endif
 
+#ifdef CONFIG_NVMAP_CARVEOUT_MOVABLE
+/*
+ * Keep the carveout in the memory map so that it can be lent to the page
+ * allocator as MIGRATE_CMA once the buddy allocator is up. The region must
+ * be pageblock aligned and lie in highmem, where the kernel has no
+ * cacheable linear mapping that could alias nvmap's uncached mappings.
+ */
+static bool __init tegra_reserve_carveout_movable(unsigned long start,
+						  unsigned long size)
+{
+	unsigned long align = PAGE_SIZE << max_t(unsigned int, MAX_ORDER - 1,
+						 pageblock_order);
+
+	if ((start | size) & (align - 1)) {
+		pr_warn("Carveout %08lx@%08lx not aligned to %lu, "
+			"not lending it to the page allocator\n",
+			size, start, align);
+		return false;
+	}
+
+	/*
+	 * This runs from arm_memblock_init(), before lowmem_limit and the
+	 * memblock limit are known: compare with where highmem will start.
+	 */
+	if (start < __pa(vmalloc_min)) {
+		pr_warn("Carveout %08lx@%08lx is in lowmem, "
+			"not lending it to the page allocator\n",
+			size, start);
+		return false;
+	}
+
+	return memblock_reserve(start, size) == 0;
+}
+
+static int __init tegra_carveout_lend(void)
+{
+	unsigned long pfn, end_pfn;
+
+	if (!tegra_carveout_movable)
+		return 0;
+
+	pfn = __phys_to_pfn(tegra_carveout_start);
+	end_pfn = pfn + (tegra_carveout_size >> PAGE_SHIFT);
+	for (; pfn < end_pfn; pfn += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+
+	pr_info("Lent carveout %08lx@%08lx to the page allocator\n",
+		tegra_carveout_size, tegra_carveout_start);
+	return 0;
+}
+core_initcall(tegra_carveout_lend);
+#else
+static inline bool tegra_reserve_carveout_movable(unsigned long start,
+						  unsigned long size)
+{
+	return false;
+}
+#endif
+
 void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	unsigned long fb2_size)
 {
@@ -839,7 +901,12 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 
 	if (carveout_size) {
 		tegra_carveout_start = memblock_end_of_DRAM() - carveout_size;
-		if (memblock_remove(tegra_carveout_start, carveout_size)) {
+		if (tegra_reserve_carveout_movable(tegra_carveout_start,
+						   carveout_size)) {
+			tegra_carveout_size = carveout_size;
+			tegra_carveout_movable = true;
+		} else if (memblock_remove(tegra_carveout_start,
+					   carveout_size)) {
 			pr_err("Failed to remove carveout %08lx@%08lx "
 				"from memory map\n",
 				carveout_size, tegra_carveout_start);
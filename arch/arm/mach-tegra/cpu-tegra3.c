@@ -69,6 +69,9 @@ module_param(mp_overhead, int, 0644);
 static int balance_level = 75;
 module_param(balance_level, int, 0644);
 
+static unsigned int up_util_level = 50;
+module_param(up_util_level, uint, 0644);
+
 static struct clk *cpu_clk;
 static struct clk *cpu_g_clk;
 static struct clk *cpu_lp_clk;
@@ -183,6 +186,18 @@ enum {
 	TEGRA_CPU_SPEED_SKEWED,
 };
 
+/* recent busy time of the online cpus, as a percentage of their capacity */
+static unsigned int tegra_cpu_avg_util(void)
+{
+	unsigned long util = 0;
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu)
+		util += sched_cpu_util(cpu);
+
+	return util * 100 / (num_online_cpus() * SCHED_LOAD_SCALE);
+}
+
 static noinline int tegra_cpu_speed_balance(void)
 {
 	unsigned long highest_speed = tegra_cpu_highest_speed();
@@ -192,7 +207,8 @@ static noinline int tegra_cpu_speed_balance(void)
 	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
 
 	/* balanced: freq targets for all CPUs are above 50% of highest speed
-	   biased: freq target for at least one CPU is below 50% threshold
+	   biased: freq target for at least one CPU is below 50% threshold,
+		   or the online CPUs are busy less than up_util_level %
 	   skewed: freq targets for at least 2 CPUs are below 25% threshold */
 	if ((tegra_count_slow_cpus(skewed_speed) >= 2) ||
 	    tegra_cpu_edp_favor_down(nr_cpus, mp_overhead) ||
@@ -201,7 +217,8 @@ static noinline int tegra_cpu_speed_balance(void)
 
 	if ((tegra_count_slow_cpus(balanced_speed) >= 1) ||
 	    (!tegra_cpu_edp_favor_up(nr_cpus, mp_overhead)) ||
-	    (nr_cpus == max_cpus))
+	    (nr_cpus == max_cpus) ||
+	    (tegra_cpu_avg_util() < up_util_level))
 		return TEGRA_CPU_SPEED_BIASED;
 
 	return TEGRA_CPU_SPEED_BALANCED;
@@ -356,6 +373,13 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 		"cpu-tegra3", WQ_UNBOUND | WQ_RESCUER | WQ_FREEZABLE, 1);
 	if (!hotplug_wq)
 		return -ENOMEM;
+
+	/*
+	 * CPU0 is the only core kept online on the LP cluster; running
+	 * housekeeping there lets the other cores stay idle or unplugged.
+	 * A mask given on the command line takes precedence.
+	 */
+	workqueue_set_power_efficient_cpus(cpumask_of(0));
 	INIT_DELAYED_WORK(&hotplug_work, tegra_auto_hotplug_work_func);
 
 	cpu_clk = clk_get_sys(NULL, "cpu");
@@ -23,6 +23,7 @@
 #include <linux/ioctl.h>
 #include <linux/file.h>
 #include <linux/rbtree.h>
+#include <linux/dma-mapping.h>
 
 #if !defined(__KERNEL__)
 #define __user
@@ -114,12 +115,40 @@ int nvmap_patch_word(struct nvmap_client *client,
 		     struct nvmap_handle *patch,
 		     u32 patch_offset, u32 patch_value);
 
+/* shareable buffers: see drivers/video/tegra/nvmap/nvmap_buf.c */
+struct device;
+struct sg_table;
+struct nvmap_buf_attachment;
+
+struct file *nvmap_buf_export(struct nvmap_client *client, unsigned long id);
+
+struct file *nvmap_buf_get(int fd);
+
+void nvmap_buf_put(struct file *file);
+
+size_t nvmap_buf_size(struct file *file);
+
+struct nvmap_handle_ref *nvmap_buf_import(struct nvmap_client *client,
+					  struct file *file);
+
+struct nvmap_buf_attachment *nvmap_buf_attach(struct file *file,
+					      struct device *dev);
+
+void nvmap_buf_detach(struct nvmap_buf_attachment *a);
+
+struct sg_table *nvmap_buf_map(struct nvmap_buf_attachment *a,
+			       enum dma_data_direction dir);
+
+void nvmap_buf_unmap(struct nvmap_buf_attachment *a, struct sg_table *sgt,
+		     enum dma_data_direction dir);
+
 struct nvmap_platform_carveout {
 	const char *name;
 	unsigned int usage_mask;
 	phys_addr_t base;
 	size_t size;
 	size_t buddy_size;
+	bool movable;	/* lent to the page allocator when unused */
 };
 
 struct nvmap_platform_data {
@@ -806,6 +806,15 @@ static const char *lp_state[TEGRA_MAX_SUSPEND_MODE] = {
 	[TEGRA_SUSPEND_LP0] = "LP0",
 };
 
+/*
+ * Timekeeping is suspended while the state is entered, so the steps are
+ * timed with the raw microsecond counter for the suspend timeline.
+ */
+static inline u32 tegra_pm_usec(void)
+{
+	return readl(IO_ADDRESS(TEGRA_TMRUS_BASE));
+}
+
 static int tegra_suspend_enter(suspend_state_t state)
 {
 	int ret;
@@ -835,6 +844,8 @@ static int tegra_suspend_enter(suspend_state_t state)
 
 	if (timespec_compare(&ts_exit, &ts_entry) > 0) {
 		delta = timespec_to_ktime(timespec_sub(ts_exit, ts_entry));
+		pm_timeline_add_span("sleep", lp_state[current_suspend_mode],
+				     ktime_to_us(delta));
 
 		tegra_dvfs_rail_pause(tegra_cpu_rail, delta, false);
 		if (current_suspend_mode == TEGRA_SUSPEND_LP0)
@@ -878,6 +889,7 @@ static void tegra_suspend_check_pwr_stats(void)
 
 int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 {
+	u32 start = tegra_pm_usec();
 	int err = 0;
 
 	if (WARN_ON(mode <= TEGRA_SUSPEND_NONE ||
@@ -931,11 +943,14 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 	outer_flush_all();
 	outer_disable();
 
+	pm_timeline_add_span("lp_save", lp_state[mode], tegra_pm_usec() - start);
+
 	if (mode == TEGRA_SUSPEND_LP2)
 		tegra_sleep_cpu(PLAT_PHYS_OFFSET - PAGE_OFFSET);
 	else
 		tegra_sleep_core(mode, PLAT_PHYS_OFFSET - PAGE_OFFSET);
 
+	start = tegra_pm_usec();
 	tegra_init_cache(true);
 
 	if (mode == TEGRA_SUSPEND_LP0) {
@@ -969,6 +984,9 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 
 	tegra_common_resume();
 
+	pm_timeline_add_span("lp_restore", lp_state[mode],
+			     tegra_pm_usec() - start);
+
 fail:
 	return err;
 }
@@ -271,6 +271,12 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+static ssize_t queue_plug_stats_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%lu %lu %lu\n", q->nr_unplugs,
+		       q->nr_unplugs_sched, q->nr_unplugged_rqs);
+}
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -379,6 +385,11 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_store_iostats,
 };
 
+static struct queue_sysfs_entry queue_plug_stats_entry = {
+	.attr = {.name = "plug_stats", .mode = S_IRUGO },
+	.show = queue_plug_stats_show,
+};
+
 static struct queue_sysfs_entry queue_random_entry = {
 	.attr = {.name = "add_random", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_show_random,
@@ -407,6 +418,7 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+	&queue_plug_stats_entry.attr,
 	NULL,
 };
 
@@ -0,0 +1,455 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler by Jens Axboe.
+ *
+ *  See Documentation/block/flash-iosched.txt
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/ioprio.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+
+#include "blk-cgroup.h"
+
+static const int bg_expire = HZ / 2;		/* background sync requests */
+static const int async_expire = HZ;		/* writeback */
+static const int discard_expire = 2 * HZ;
+static const int writes_starved = 16;	/* sync requests before a write batch */
+static const int write_batch_ms = 40;	/* write batch length, at measured speed */
+static const unsigned int write_kbs_init = 8192;	/* until measured */
+
+/* throughput is measured over this much device busy time */
+#define FLASH_SAMPLE_US		(100 * USEC_PER_MSEC)
+
+/*
+ * Requests are kept in one fifo per class, served in this order of
+ * preference.  Flash has no seek penalty, so there is no sorting.
+ */
+enum {
+	FLASH_SYNC,		/* reads and sync writes (fsync) */
+	FLASH_BG_SYNC,		/* the same, from background tasks */
+	FLASH_ASYNC,		/* writeback */
+	FLASH_DISCARD,
+	FLASH_CLASSES,
+};
+
+/* rq->elevator_private[] */
+#define rq_flash_class(rq)	((unsigned long) (rq)->elevator_private[0])
+#define rq_set_flash_class(rq, c) \
+	((rq)->elevator_private[0] = (void *) (unsigned long) (c))
+#define rq_flash_start(rq)	((unsigned long) (rq)->elevator_private[1])
+#define rq_flash_bytes(rq)	((unsigned long) (rq)->elevator_private[2])
+
+/* set on a request from a background task until it is added */
+#define FLASH_BG_FLAG		(1UL << 8)
+
+struct flash_data {
+	struct list_head fifo_list[FLASH_CLASSES];
+
+	int batch_class;		/* class being served */
+	unsigned int batch_bytes;	/* dispatched in the current batch */
+	unsigned int starved;		/* sync requests served over writes */
+
+	/* write throughput measurement */
+	unsigned int write_kbs;
+	unsigned long last_complete;	/* usecs */
+	unsigned int sample_bytes;
+	unsigned int sample_us;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_CLASSES];
+	int writes_starved;
+	int write_batch_ms;
+};
+
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+/*
+ * Background tasks are those with an idle or lowered io priority, which
+ * Android's background threads get from their nice level, and those in a
+ * blkio cgroup with less than the default weight.
+ */
+static bool flash_task_is_bg(struct task_struct *tsk)
+{
+	struct io_context *ioc = tsk->io_context;
+	int class, prio;
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_CGROUP_MODULE)
+	struct blkio_cgroup *blkcg;
+	bool light;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(tsk);
+	light = blkcg && blkcg->weight < BLKIO_WEIGHT_DEFAULT;
+	rcu_read_unlock();
+	if (light)
+		return true;
+#endif
+
+	if (ioc && ioprio_valid(ioc->ioprio)) {
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+		prio = IOPRIO_PRIO_DATA(ioc->ioprio);
+	} else {
+		class = task_nice_ioclass(tsk);
+		prio = task_nice_ioprio(tsk);
+	}
+
+	if (class == IOPRIO_CLASS_IDLE || tsk->policy == SCHED_BATCH)
+		return true;
+	return class == IOPRIO_CLASS_BE && prio > IOPRIO_NORM;
+}
+
+static int
+flash_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	rq_set_flash_class(rq, flash_task_is_bg(current) ? FLASH_BG_FLAG : 0);
+	return 0;
+}
+
+static int flash_rq_class(struct request *rq)
+{
+	if (rq->cmd_flags & REQ_DISCARD)
+		return FLASH_DISCARD;
+	if (!rq_is_sync(rq))
+		return FLASH_ASYNC;
+	if (rq_flash_class(rq) & FLASH_BG_FLAG)
+		return FLASH_BG_SYNC;
+	return FLASH_SYNC;
+}
+
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int class = flash_rq_class(rq);
+
+	rq_set_flash_class(rq, class);
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[class]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class]);
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    rq_flash_class(req) == rq_flash_class(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	rq_fifo_clear(next);
+}
+
+static struct request *
+flash_former_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.prev == &fd->fifo_list[rq_flash_class(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.prev);
+}
+
+static struct request *
+flash_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.next == &fd->fifo_list[rq_flash_class(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.next);
+}
+
+/*
+ * The request is going to the device: remember when and how much, to
+ * measure the write throughput when it completes.
+ */
+static void flash_activate_request(struct request_queue *q, struct request *rq)
+{
+	rq->elevator_private[1] = (void *) flash_now_us();
+	rq->elevator_private[2] = (void *) (unsigned long) blk_rq_bytes(rq);
+}
+
+/*
+ * Only the time the device is busy with writes counts, so that
+ * overlapping requests (e.g. eMMC packed writes) are not counted twice.
+ */
+static void flash_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned long now, start;
+	unsigned int sample;
+
+	if (rq_flash_class(rq) == FLASH_DISCARD || rq_data_dir(rq) != WRITE ||
+	    !rq_flash_bytes(rq))
+		return;
+
+	now = flash_now_us();
+	start = rq_flash_start(rq);
+	if ((long) (fd->last_complete - start) > 0)
+		start = fd->last_complete;
+	if ((long) (now - start) > 0)
+		fd->sample_us += now - start;
+	fd->sample_bytes += rq_flash_bytes(rq);
+	fd->last_complete = now;
+
+	if (fd->sample_us < FLASH_SAMPLE_US)
+		return;
+
+	/* bytes per usec to KB per sec, then a running average */
+	sample = div_u64((u64) fd->sample_bytes * USEC_PER_SEC,
+			 fd->sample_us * 1024);
+	fd->write_kbs = (fd->write_kbs * 7 + sample) / 8;
+	if (!fd->write_kbs)
+		fd->write_kbs = 1;
+	fd->sample_bytes = 0;
+	fd->sample_us = 0;
+}
+
+/*
+ * How much a write batch may dispatch, so that it takes about
+ * write_batch_ms for the device to write it.
+ */
+static inline unsigned int flash_write_budget(struct flash_data *fd)
+{
+	return fd->write_kbs * fd->write_batch_ms / MSEC_PER_SEC * 1024;
+}
+
+/*
+ * flash_check_fifo returns 0 if there are no expired requests on the fifo,
+ * 1 otherwise. Requires !list_empty(&fd->fifo_list[class])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int class)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[class].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static int flash_choose_class(struct flash_data *fd)
+{
+	const int sync = !list_empty(&fd->fifo_list[FLASH_SYNC]);
+	const int bg_sync = !list_empty(&fd->fifo_list[FLASH_BG_SYNC]);
+	const int async = !list_empty(&fd->fifo_list[FLASH_ASYNC]);
+	const int discard = !list_empty(&fd->fifo_list[FLASH_DISCARD]);
+
+	/*
+	 * expired requests of the lower classes first, so that a steady
+	 * stream of foreground reads can only delay them, not starve them
+	 */
+	if (async && (fd->starved >= fd->writes_starved ||
+		      flash_check_fifo(fd, FLASH_ASYNC)))
+		return FLASH_ASYNC;
+	if (bg_sync && flash_check_fifo(fd, FLASH_BG_SYNC))
+		return FLASH_BG_SYNC;
+	if (discard && flash_check_fifo(fd, FLASH_DISCARD))
+		return FLASH_DISCARD;
+
+	if (sync || bg_sync) {
+		if (async)
+			fd->starved++;
+		return sync ? FLASH_SYNC : FLASH_BG_SYNC;
+	}
+	if (async)
+		return FLASH_ASYNC;
+	if (discard)
+		return FLASH_DISCARD;
+	return -1;
+}
+
+/*
+ * flash_dispatch_requests serves sync requests first.  Once writes get
+ * their turn, they are dispatched in a batch sized by the measured write
+ * throughput, so the next read waits about write_batch_ms at most.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+	int class;
+
+	if (fd->batch_class == FLASH_ASYNC &&
+	    !list_empty(&fd->fifo_list[FLASH_ASYNC]) &&
+	    fd->batch_bytes < flash_write_budget(fd))
+		class = FLASH_ASYNC;
+	else {
+		class = flash_choose_class(fd);
+		if (class < 0)
+			return 0;
+		if (class == FLASH_ASYNC)
+			fd->starved = 0;
+		fd->batch_class = class;
+		fd->batch_bytes = 0;
+	}
+
+	rq = rq_entry_fifo(fd->fifo_list[class].next);
+	fd->batch_bytes += blk_rq_bytes(rq);
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(q, rq);
+
+	return 1;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int i;
+
+	for (i = 0; i < FLASH_CLASSES; i++)
+		BUG_ON(!list_empty(&fd->fifo_list[i]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int i;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (i = 0; i < FLASH_CLASSES; i++)
+		INIT_LIST_HEAD(&fd->fifo_list[i]);
+	fd->batch_class = FLASH_SYNC;
+	fd->write_kbs = write_kbs_init;
+	fd->fifo_expire[FLASH_BG_SYNC] = bg_expire;
+	fd->fifo_expire[FLASH_ASYNC] = async_expire;
+	fd->fifo_expire[FLASH_DISCARD] = discard_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch_ms = write_batch_ms;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_bg_expire_show, fd->fifo_expire[FLASH_BG_SYNC], 1);
+SHOW_FUNCTION(flash_async_expire_show, fd->fifo_expire[FLASH_ASYNC], 1);
+SHOW_FUNCTION(flash_discard_expire_show, fd->fifo_expire[FLASH_DISCARD], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_ms_show, fd->write_batch_ms, 0);
+SHOW_FUNCTION(flash_write_kbs_show, fd->write_kbs, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_bg_expire_store, &fd->fifo_expire[FLASH_BG_SYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_expire_store, &fd->fifo_expire[FLASH_ASYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_discard_expire_store, &fd->fifo_expire[FLASH_DISCARD], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_ms_store, &fd->write_batch_ms, 1, 1000, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(bg_expire),
+	FD_ATTR(async_expire),
+	FD_ATTR(discard_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch_ms),
+	__ATTR(write_kbs, S_IRUGO, flash_write_kbs_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_activate_req_fn =	flash_activate_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_former_req_fn =	flash_former_request,
+		.elevator_latter_req_fn =	flash_latter_request,
+		.elevator_set_req_fn =		flash_set_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Flash IO scheduler");
@@ -190,14 +190,16 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
- * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ * @async: If unset, wait only if the device's power.async_suspend or
+ *	power.async_resume flag is set.
  */
 static void dpm_wait(struct device *dev, bool async)
 {
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || (pm_async_enabled &&
+		      (dev->power.async_suspend || dev->power.async_resume)))
 		wait_for_completion(&dev->power.completion);
 }
 
@@ -466,13 +468,16 @@ void dpm_resume_noirq(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_noirq_list)) {
 		struct device *dev = to_device(dpm_noirq_list.next);
+		ktime_t calltime;
 		int error;
 
 		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_suspended_list);
 		mutex_unlock(&dpm_list_mtx);
 
+		calltime = ktime_get();
 		error = device_resume_noirq(dev, state);
+		pm_timeline_add("resume_noirq", dev_name(dev), calltime, error);
 		if (error)
 			pm_dev_err(dev, state, " early", error);
 
@@ -481,6 +486,7 @@ void dpm_resume_noirq(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	dpm_show_time(starttime, state, "early");
+	pm_timeline_add("resume_noirq", NULL, starttime, 0);
 	resume_device_irqs();
 }
 EXPORT_SYMBOL_GPL(dpm_resume_noirq);
@@ -513,12 +519,14 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
 	dpm_wait(dev->parent, async);
+	calltime = ktime_get();
 	device_lock(dev);
 
 	/*
@@ -569,6 +577,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  Unlock:
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
+	pm_timeline_add("resume", dev_name(dev), calltime, error);
 
 	TRACE_RESUME(error);
 	return error;
@@ -591,6 +600,12 @@ static bool is_async(struct device *dev)
 		&& !pm_trace_is_enabled();
 }
 
+static bool is_async_resume(struct device *dev)
+{
+	return dev->power.async_resume && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -642,7 +657,14 @@ static void dpm_resume(pm_message_t state)
 	while (!list_empty(&dpm_suspended_list)) {
 		dev = to_device(dpm_suspended_list.next);
 		get_device(dev);
-		if (!is_async(dev)) {
+		if (!is_async(dev) && is_async_resume(dev)) {
+			/*
+			 * Everything before it has been resumed or is being
+			 * resumed; only its children will wait for it.
+			 */
+			get_device(dev);
+			async_schedule(async_resume, dev);
+		} else if (!is_async(dev)) {
 			int error;
 
 			mutex_unlock(&dpm_list_mtx);
@@ -660,6 +682,7 @@ static void dpm_resume(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+	pm_timeline_add("resume", NULL, starttime, 0);
 }
 
 /**
@@ -702,25 +725,30 @@ static void device_complete(struct device *dev, pm_message_t state)
  */
 static void dpm_complete(pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	struct list_head list;
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
+		ktime_t calltime;
 
 		get_device(dev);
 		dev->power.is_prepared = false;
 		list_move(&dev->power.entry, &list);
 		mutex_unlock(&dpm_list_mtx);
 
+		calltime = ktime_get();
 		device_complete(dev, state);
+		pm_timeline_add("complete", dev_name(dev), calltime, 0);
 
 		mutex_lock(&dpm_list_mtx);
 		put_device(dev);
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	pm_timeline_add("complete", NULL, starttime, 0);
 }
 
 /**
@@ -815,11 +843,14 @@ int dpm_suspend_noirq(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_suspended_list)) {
 		struct device *dev = to_device(dpm_suspended_list.prev);
+		ktime_t calltime;
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
+		calltime = ktime_get();
 		error = device_suspend_noirq(dev, state);
+		pm_timeline_add("suspend_noirq", dev_name(dev), calltime, error);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
@@ -832,6 +863,7 @@ int dpm_suspend_noirq(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	pm_timeline_add("suspend_noirq", NULL, starttime, error);
 	if (error)
 		dpm_resume_noirq(resume_event(state));
 	else
@@ -873,8 +905,10 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	int error = 0;
 	struct timer_list timer;
 	struct dpm_drv_wd_data data;
+	ktime_t calltime;
 
 	dpm_wait_for_children(dev, async);
+	calltime = ktime_get();
 
 	data.dev = dev;
 	data.tsk = get_current();
@@ -937,6 +971,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	destroy_timer_on_stack(&timer);
 
 	complete_all(&dev->power.completion);
+	pm_timeline_add("suspend", dev_name(dev), calltime, error);
 
 	if (error)
 		async_error = error;
@@ -1007,6 +1042,7 @@ static int dpm_suspend(pm_message_t state)
 		error = async_error;
 	if (!error)
 		dpm_show_time(starttime, state, NULL);
+	pm_timeline_add("suspend", NULL, starttime, error);
 	return error;
 }
 
@@ -1066,15 +1102,18 @@ static int device_prepare(struct device *dev, pm_message_t state)
  */
 static int dpm_prepare(pm_message_t state)
 {
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_list)) {
 		struct device *dev = to_device(dpm_list.next);
+		ktime_t calltime;
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
+		calltime = ktime_get();
 		pm_runtime_get_noresume(dev);
 		if (pm_runtime_barrier(dev) && device_may_wakeup(dev))
 			pm_wakeup_event(dev, 0);
@@ -1082,6 +1121,7 @@ static int dpm_prepare(pm_message_t state)
 		pm_runtime_put_sync(dev);
 		error = pm_wakeup_pending() ?
 				-EBUSY : device_prepare(dev, state);
+		pm_timeline_add("prepare", dev_name(dev), calltime, error);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
@@ -1102,6 +1142,7 @@ static int dpm_prepare(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	pm_timeline_add("prepare", NULL, starttime, error);
 	return error;
 }
 
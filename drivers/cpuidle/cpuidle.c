@@ -42,6 +42,41 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/**
+ * cpuidle_account_miss - checks the last residency against the states
+ * @dev: the CPU
+ * @state: the state that was entered
+ *
+ * A state left before its target residency cost more than it saved
+ * (too_short); one left after a deeper state would have paid off
+ * wasted the chance to save more (too_long).
+ */
+static void cpuidle_account_miss(struct cpuidle_device *dev,
+				 struct cpuidle_state *state)
+{
+	int i;
+
+	if (!(state->flags & CPUIDLE_FLAG_TIME_VALID))
+		return;
+
+	if (dev->last_residency < state->target_residency) {
+		state->too_short++;
+		return;
+	}
+
+	for (i = state - dev->states + 1; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (dev->last_residency >= s->target_residency &&
+		    s->power_usage < state->power_usage) {
+			state->too_long++;
+			return;
+		}
+	}
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -110,6 +145,7 @@ static void cpuidle_idle_call(void)
 
 	target_state->time += (unsigned long long)dev->last_residency;
 	target_state->usage++;
+	cpuidle_account_miss(dev, target_state);
 
 	/* give the governor an opportunity to reflect on the outcome */
 	if (cpuidle_curr_governor->reflect)
@@ -236,6 +272,8 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states[i].usage = 0;
 		dev->states[i].time = 0;
+		dev->states[i].too_short = 0;
+		dev->states[i].too_long = 0;
 	}
 	dev->last_residency = 0;
 	dev->last_state = NULL;
@@ -0,0 +1,294 @@
+/*
+ * pattern.c - the pattern idle governor
+ *
+ * Based on the menu governor by Adam Belay and Arjan van de Ven.
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+
+#define HISTORY 16
+#define MAX_PERIOD 4
+#define MATCH_PCT 12
+#define MATCH_MIN_US 50
+#define MISS_STREAK 3
+#define RESOLUTION 1024
+#define DECAY 8
+#define MAX_INTERESTING 50000
+
+/*
+ * Concepts behind the pattern governor
+ *
+ * Like menu, the pattern governor picks the lowest power state whose
+ * target residency fits the predicted idle duration and whose exit
+ * latency is tolerable. It differs in how the duration is predicted.
+ *
+ * Repeating periods
+ * -----------------
+ * Much of the idle time on a phone or tablet is cut by periodic events:
+ * display vsync, audio buffers, polling timers. Each cpu keeps the last
+ * 16 idle durations it measured, and looks for a sequence of 1 to 4
+ * durations that repeats at the end of the history (e.g. A, A, A or
+ * A, B, A, B). When one is found, the next duration is predicted to be
+ * the one that follows in the sequence, as long as that comes before
+ * the next timer event.
+ *
+ * Correction factor
+ * -----------------
+ * Without a pattern, the time to the next timer event is scaled by a
+ * running average of measured / expected duration, kept per cpu, since
+ * the cpus of a system see very different interrupt loads.
+ *
+ * Miss streaks
+ * ------------
+ * A state that was left before its target residency a few times in a
+ * row is only used again when the prediction is at least twice its
+ * target residency, so a cpu that keeps getting woken up early backs
+ * off to a shallower state instead of paying the entry/exit cost.
+ *
+ * How often each state was left too early (too_short) or could have
+ * been deeper (too_long) is in the states' sysfs directories.
+ */
+
+struct pattern_device {
+	int		last_state_idx;
+	int		needs_update;
+
+	unsigned int	expected_us;
+	unsigned int	predicted_us;
+	unsigned int	exit_us;
+	u64		correction_factor;
+
+	unsigned int	history[HISTORY];
+	unsigned int	history_ptr;
+	unsigned int	history_len;
+
+	unsigned int	short_streak[CPUIDLE_STATE_MAX];
+};
+
+static DEFINE_PER_CPU(struct pattern_device, pattern_devices);
+
+static void pattern_update(struct cpuidle_device *dev);
+
+/* the n-th most recent idle duration, 0 being the last one */
+static inline unsigned int history(struct pattern_device *data, int n)
+{
+	return data->history[(data->history_ptr + HISTORY - 1 - n) % HISTORY];
+}
+
+static inline bool durations_match(unsigned int a, unsigned int b)
+{
+	unsigned int diff = a > b ? a - b : b - a;
+
+	return diff <= max_t(unsigned int, MATCH_MIN_US,
+			     max(a, b) * MATCH_PCT / 100);
+}
+
+/*
+ * Looks for a sequence of 1 to MAX_PERIOD durations repeating at the end
+ * of the history, and returns the duration that should come next, or 0.
+ * A sequence must have been seen at least twice, and single durations
+ * three times, before it is trusted.
+ */
+static unsigned int detect_period(struct pattern_device *data)
+{
+	int period, i;
+
+	for (period = 1; period <= MAX_PERIOD; period++) {
+		int window = max(2 * period, 3);
+
+		if (data->history_len < window)
+			break;
+
+		for (i = 0; i + period < window; i++)
+			if (!durations_match(history(data, i),
+					     history(data, i + period)))
+				break;
+
+		if (i + period == window)
+			/* be conservative: the shorter of the two samples */
+			return min(history(data, period - 1),
+				   history(data, 2 * period - 1));
+	}
+	return 0;
+}
+
+/**
+ * pattern_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int pattern_select(struct cpuidle_device *dev)
+{
+	struct pattern_device *data = &__get_cpu_var(pattern_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int power_usage = -1;
+	unsigned int predicted;
+	int multiplier;
+	struct timespec t;
+	int i;
+
+	if (data->needs_update) {
+		pattern_update(dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = 0;
+	data->exit_us = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	data->expected_us =
+		t.tv_sec * USEC_PER_SEC + t.tv_nsec / NSEC_PER_USEC;
+
+	if (data->correction_factor == 0)
+		data->correction_factor = RESOLUTION * DECAY;
+
+	predicted = detect_period(data);
+	if (!predicted || predicted > data->expected_us)
+		predicted = div_u64((u64)data->expected_us *
+				    data->correction_factor +
+				    RESOLUTION * DECAY / 2,
+				    RESOLUTION * DECAY);
+	data->predicted_us = predicted;
+
+	/* each task waiting for IO on this cpu makes deep states costlier */
+	multiplier = 1 + 10 * nr_iowait_cpu(smp_processor_id());
+
+	if (data->expected_us > 5)
+		data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (s->target_residency > predicted)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (s->exit_latency * multiplier > predicted)
+			continue;
+		if (data->short_streak[i] >= MISS_STREAK &&
+		    s->target_residency * 2 > predicted)
+			continue;
+
+		if (s->power_usage < power_usage) {
+			power_usage = s->power_usage;
+			data->last_state_idx = i;
+			data->exit_us = s->exit_latency;
+		}
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * pattern_reflect - records that data structures need update
+ * @dev: the CPU
+ */
+static void pattern_reflect(struct cpuidle_device *dev)
+{
+	struct pattern_device *data = &__get_cpu_var(pattern_devices);
+	data->needs_update = 1;
+}
+
+/**
+ * pattern_update - learns from the last idle period
+ * @dev: the CPU
+ */
+static void pattern_update(struct cpuidle_device *dev)
+{
+	struct pattern_device *data = &__get_cpu_var(pattern_devices);
+	int idx = data->last_state_idx;
+	struct cpuidle_state *target;
+	unsigned int measured_us;
+	u64 new_factor;
+
+	/* the driver may have demoted the state we asked for */
+	if (dev->last_state)
+		idx = dev->last_state - dev->states;
+	target = &dev->states[idx];
+
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
+		measured_us = data->expected_us;
+	else
+		measured_us = cpuidle_get_last_residency(dev);
+
+	if (measured_us > data->exit_us)
+		measured_us -= data->exit_us;
+
+	if (measured_us < target->target_residency)
+		data->short_streak[idx]++;
+	else
+		data->short_streak[idx] = 0;
+
+	new_factor = data->correction_factor * (DECAY - 1) / DECAY;
+	if (data->expected_us > 0 && measured_us < MAX_INTERESTING)
+		new_factor += RESOLUTION *
+			min(measured_us, data->expected_us) / data->expected_us;
+	else
+		new_factor += RESOLUTION;
+	if (new_factor == 0)
+		new_factor = 1;
+	data->correction_factor = new_factor;
+
+	data->history[data->history_ptr] = measured_us;
+	data->history_ptr = (data->history_ptr + 1) % HISTORY;
+	if (data->history_len < HISTORY)
+		data->history_len++;
+}
+
+/**
+ * pattern_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int pattern_enable_device(struct cpuidle_device *dev)
+{
+	struct pattern_device *data = &per_cpu(pattern_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct pattern_device));
+
+	return 0;
+}
+
+static struct cpuidle_governor pattern_governor = {
+	.name =		"pattern",
+	.rating =	25,
+	.enable =	pattern_enable_device,
+	.select =	pattern_select,
+	.reflect =	pattern_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_pattern - initializes the governor
+ */
+static int __init init_pattern(void)
+{
+	return cpuidle_register_governor(&pattern_governor);
+}
+
+/**
+ * exit_pattern - exits the governor
+ */
+static void __exit exit_pattern(void)
+{
+	cpuidle_unregister_governor(&pattern_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_pattern);
+module_exit(exit_pattern);
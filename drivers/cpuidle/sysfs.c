@@ -247,6 +247,8 @@ define_show_state_function(exit_latency)
 define_show_state_function(power_usage)
 define_show_state_ull_function(usage)
 define_show_state_ull_function(time)
+define_show_state_ull_function(too_short)
+define_show_state_ull_function(too_long)
 define_show_state_str_function(name)
 define_show_state_str_function(desc)
 
@@ -256,6 +258,8 @@ define_one_state_ro(latency, show_state_exit_latency);
 define_one_state_ro(power, show_state_power_usage);
 define_one_state_ro(usage, show_state_usage);
 define_one_state_ro(time, show_state_time);
+define_one_state_ro(too_short, show_state_too_short);
+define_one_state_ro(too_long, show_state_too_long);
 
 static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_name.attr,
@@ -264,6 +268,8 @@ static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_power.attr,
 	&attr_usage.attr,
 	&attr_time.attr,
+	&attr_too_short.attr,
+	&attr_too_long.attr,
 	NULL
 };
 
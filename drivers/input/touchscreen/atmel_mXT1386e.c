@@ -1771,6 +1771,7 @@ static int mxt_probe(struct i2c_client *client, const struct i2c_device_id *id)
 	mxt->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	mxt->early_suspend.suspend = mxt_early_suspend;
 	mxt->early_suspend.resume = mxt_late_resume;
+	mxt->early_suspend.async = true;
 	register_early_suspend(&mxt->early_suspend);
 #endif
 	return 0;
@@ -37,6 +37,8 @@
 #include <linux/mmc/mmc.h>
 #include <linux/mmc/sd.h>
 
+#include <trace/events/block.h>
+
 #include <asm/system.h>
 #include <asm/uaccess.h>
 
@@ -169,11 +171,13 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_CMD_ERR,
+	MMC_BLK_DATA_ERR,
+	MMC_BLK_NOMEDIUM,
 };
 
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
@@ -308,6 +312,21 @@ out:
 	return err ? 0 : 1;
 }
 
+static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
+
+	ret = mmc_flush_cache(card);
+
+	spin_lock_irq(&md->lock);
+	__blk_end_request_all(req, ret ? -EIO : 0);
+	spin_unlock_irq(&md->lock);
+
+	return ret ? 0 : 1;
+}
+
 static int mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
 				       struct request *req)
 {
@@ -361,221 +380,618 @@ out:
 	return err ? 0 : 1;
 }
 
-static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+/*
+ * Before eMMC 4.5 the exception bit of R1 only meant urgent BKOPS. Later
+ * cards also raise it for other events, which EXT_CSD tells apart.
+ */
+static void mmc_blk_exception_event(struct mmc_card *card)
 {
-	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
+	u8 *ext_csd;
 
-	mmc_claim_host(card->host);
+	if (card->ext_csd.rev < 6) {
+		mmc_card_set_need_bkops(card);
+		return;
+	}
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (ext_csd && !mmc_send_ext_csd(card, ext_csd) &&
+	    (ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_URGENT_BKOPS))
+		mmc_card_set_need_bkops(card);
+	kfree(ext_csd);
+}
 
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
+/*
+ * Called by mmc_start_req() when the host has completed a request, before
+ * the next one is started. Any status but MMC_BLK_SUCCESS keeps the next
+ * request from being started.
+ */
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
+	struct mmc_command cmd;
+	u32 status = 0;
 
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.cmd.retries = MMC_CMD_RETRIES;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	/*
+	 * Check for errors here, but don't return MMC_BLK_CMD_ERR
+	 * until later as we need to wait for the card to leave
+	 * programming mode even when things go wrong.
+	 */
+	if (brq->sbc.error || brq->cmd.error || brq->data.error ||
+	    brq->stop.error) {
+#if defined(CONFIG_ARCH_ACER_T20)
+		if (card->host->index == 1)
+			return MMC_BLK_NOMEDIUM;
+#elif defined(CONFIG_ARCH_ACER_T30)
+		if (card->host->index == 2)
+			return MMC_BLK_NOMEDIUM;
+#endif
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			printk(KERN_WARNING "%s: retrying using single "
+			       "block read\n", req->rq_disk->disk_name);
+			return MMC_BLK_RETRY_SINGLE;
+		}
+		status = get_card_status(card, req);
+	}
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+	if (brq->sbc.error) {
+		printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->sbc.error,
+		       brq->sbc.resp[0], status);
+	}
+
+	if (brq->cmd.error) {
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+		if (brq->cmd.error == -ENOMEDIUM)
+			return MMC_BLK_CMD_ERR;
+	}
+
+	if (brq->data.error) {
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
+	if (brq->stop.error) {
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
+
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+
+			memset(&cmd, 0, sizeof(struct mmc_command));
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
 			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+
+#if 0
+		if (cmd.resp[0] & ~0x00000900)
+			printk(KERN_ERR "%s: status = %08x\n",
+			       req->rq_disk->disk_name, cmd.resp[0]);
+		if (mmc_decode_status(cmd.resp))
+			return MMC_BLK_CMD_ERR;
+#endif
+	}
+
+	if (brq->sbc.error || brq->cmd.error || brq->stop.error ||
+	    brq->data.error) {
+		if (rq_data_dir(req) == READ)
+			return MMC_BLK_DATA_ERR;
+		return MMC_BLK_CMD_ERR;
+	}
+
+	/* mmc_blk_packed_err_check() reads the events of packed writes */
+	if ((brq->cmd.resp[0] & R1_EXCEPTION_EVENT) &&
+	    mq_mrq->packed_cmd == MMC_PACKED_NONE)
+		mmc_blk_exception_event(card);
+
+	if (mq_mrq->packed_cmd == MMC_PACKED_NONE &&
+	    blk_rq_bytes(req) != brq->data.bytes_xfered)
+		return MMC_BLK_PARTIAL;
+
+	return MMC_BLK_SUCCESS;
+}
+
+/*
+ * A packed write either went through as a whole or, when the card sets
+ * the exception bit, EXT_CSD tells which entry failed. The entries before
+ * it were written. Without that information every entry is redone.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	int status;
+	u32 card_status;
+	u8 *ext_csd;
+
+	mq_rq->packed_fail_idx = MMC_PACKED_N_IDX;
+
+	status = mmc_blk_err_check(card, areq);
+	card_status = get_card_status(card, mq_rq->req);
+	if (status == MMC_BLK_SUCCESS && !(card_status & R1_EXCEPTION_EVENT))
+		return MMC_BLK_SUCCESS;
+
+	if (status != MMC_BLK_SUCCESS)
+		mq_rq->packed_fail_idx = 0;
+
+	if (card_status & R1_EXCEPTION_EVENT) {
+		ext_csd = kmalloc(512, GFP_KERNEL);
+		if (ext_csd && mmc_send_ext_csd(card, ext_csd)) {
+			kfree(ext_csd);
+			ext_csd = NULL;
 		}
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
+		if (ext_csd && (ext_csd[EXT_CSD_EXP_EVENTS_STATUS] &
+				EXT_CSD_URGENT_BKOPS))
+			mmc_card_set_need_bkops(card);
+		if (ext_csd && (ext_csd[EXT_CSD_EXP_EVENTS_STATUS] &
+				EXT_CSD_PACKED_FAILURE)) {
+			mq_rq->packed_fail_idx = 0;
+			/* the failure index counts from 1 */
+			if ((ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+			     EXT_CSD_PACKED_INDEXED_ERROR) &&
+			    ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] > 0 &&
+			    ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] <=
+			    mq_rq->packed_num)
+				mq_rq->packed_fail_idx =
+				    ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
 		}
+		kfree(ext_csd);
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	if (mq_rq->packed_fail_idx == MMC_PACKED_N_IDX)
+		return MMC_BLK_SUCCESS;
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	printk(KERN_ERR "%s: packed write of %u requests failed at %d\n",
+	       mq_rq->req->rq_disk->disk_name, mq_rq->packed_num,
+	       mq_rq->packed_fail_idx);
+	return MMC_BLK_PARTIAL;
+}
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->cmd.retries = MMC_CMD_RETRIES;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
+
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
+
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
+
+	if (brq->data.blocks > 1) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
+		if (!mmc_host_is_spi(card->host) ||
+		    rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			brq.data.sg_len = i;
 		}
+		brq->data.sg_len = i;
+	}
 
-		mmc_queue_bounce_pre(mq);
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	mmc_queue_bounce_pre(mq, mqrq);
+}
 
-		mmc_queue_bounce_post(mq);
+static inline bool mmc_blk_packable(struct request *req)
+{
+	return rq_data_dir(req) == WRITE &&
+	       !(req->cmd_flags & (REQ_DISCARD | REQ_FLUSH | REQ_FUA));
+}
 
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
-		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-#if defined(CONFIG_ARCH_ACER_T20)
-			if (card->host->index == 1) {
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -ENODEV, brq.data.blksz * brq.data.blocks);
-				spin_unlock_irq(&md->lock);
-				continue;
-			}
-#elif defined(CONFIG_ARCH_ACER_T30)
-			if (card->host->index == 2) {
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -ENODEV, brq.data.blksz * brq.data.blocks);
-				spin_unlock_irq(&md->lock);
-				continue;
-			}
-#endif
+/*
+ * Takes the writes queued behind req into one packed write, as long as
+ * they and the header fit into a single host request.
+ */
+static void mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct request *next;
+	unsigned int max_num, max_blocks, max_segs;
+	unsigned int num = 1, blocks, segs;
+
+	mqrq->packed_cmd = MMC_PACKED_NONE;
+	mqrq->packed_num = 0;
+
+	if (!mq->packed_write || !mqrq->packed_cmd_hdr ||
+	    !mmc_blk_packable(req))
+		return;
+
+	max_num = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			MMC_PACKED_MAX);
+	/* the header takes one block and one segment */
+	max_blocks = min(card->host->max_blk_count,
+			 card->host->max_req_size >> 9) - 1;
+	max_segs = card->host->max_segs - 1;
+
+	blocks = blk_rq_sectors(req);
+	segs = req->nr_phys_segments;
+	if (blocks > max_blocks || segs > max_segs)
+		goto out;
 
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name);
-				disable_multi = 1;
-				continue;
-			}
-			status = get_card_status(card, req);
-		} else if (disable_multi == 1) {
-			disable_multi = 0;
-		}
+	spin_lock_irq(q->queue_lock);
+	while (num < max_num) {
+		next = blk_peek_request(q);
+		if (!next || !mmc_blk_packable(next) ||
+		    blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
+
+		blk_start_request(next);
+		if (num == 1)
+			list_add_tail(&req->queuelist, &mqrq->packed_list);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
 
-		if (brq.cmd.error) {
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
-			if (brq.cmd.error == -ENOMEDIUM)
-				goto cmd_err;
-		}
+	if (num > 1) {
+		mqrq->packed_cmd = MMC_PACKED_WRITE;
+		mqrq->packed_num = num;
+		mqrq->packed_blocks = blocks;
+	}
+ out:
+	mq->packed_stats.packed[num]++;
+}
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	__le32 *hdr = mqrq->packed_cmd_hdr;
+	int i = 1;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+	hdr[0] = cpu_to_le32((mqrq->packed_num << 16) |
+			     (MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		u32 addr = blk_rq_pos(prq);
 
-		if (brq.stop.error) {
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
-		}
+		if (!mmc_card_blockaddr(card))
+			addr <<= 9;
+		/* arguments of the CMD23 and CMD25 of each entry */
+		hdr[i * 2] = cpu_to_le32(blk_rq_sectors(prq));
+		hdr[i * 2 + 1] = cpu_to_le32(addr);
+		i++;
+	}
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.stop = &brq->stop;
 
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (mqrq->packed_blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	/* only sent by the host if the transfer fails */
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+}
+
+static void mmc_blk_rw_rq_prep_any(struct mmc_queue_req *mqrq,
+				   struct mmc_card *card,
+				   struct mmc_queue *mq)
+{
+	if (mqrq->packed_cmd == MMC_PACKED_WRITE)
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+	else
+		mmc_blk_rw_rq_prep(mqrq, card, 0, mq);
+}
+
+/*
+ * A request transferred in full is completed from the block softirq, so
+ * that a burst of completions (e.g. a packed write) is handled in one go
+ * while mmcqd moves on to the next request.
+ */
+static void mmc_blk_complete_rq(struct request *req)
+{
+	req->errors = 0;
+	blk_complete_request(req);
+}
+
+/*
+ * Completes the packed requests the card has written, which is all of
+ * them unless an entry failed. Of the others, all but the first are put
+ * back on the queue; the first one is left in mq_rq->req to be redone on
+ * its own and 1 is returned.
+ */
+static int mmc_blk_end_packed_req(struct mmc_queue *mq,
+				  struct mmc_queue_req *mq_rq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct request *prq, *tmp;
+	int idx = 0, ret = 0;
+
+	if (mq_rq->packed_fail_idx != MMC_PACKED_N_IDX)
+		mq->packed_stats.failed++;
+
+	spin_lock_irq(&md->lock);
+	list_for_each_entry_safe(prq, tmp, &mq_rq->packed_list, queuelist) {
+		if (mq_rq->packed_fail_idx != MMC_PACKED_N_IDX &&
+		    idx == mq_rq->packed_fail_idx)
+			break;
+		list_del_init(&prq->queuelist);
+		mmc_blk_complete_rq(prq);
+		idx++;
+	}
+
+	if (!list_empty(&mq_rq->packed_list)) {
+		mq_rq->req = list_first_entry(&mq_rq->packed_list,
+					      struct request, queuelist);
+		list_del_init(&mq_rq->req->queuelist);
+		list_for_each_entry_safe_reverse(prq, tmp,
+						 &mq_rq->packed_list,
+						 queuelist) {
+			list_del_init(&prq->queuelist);
+			blk_requeue_request(mq->queue, prq);
 		}
+		ret = 1;
+	}
+	spin_unlock_irq(&md->lock);
+
+	mq_rq->packed_cmd = MMC_PACKED_NONE;
+	mq_rq->packed_num = 0;
+
+	return ret;
+}
+
+/* tell blktrace when the host has really started on the request(s) */
+static void mmc_blk_trace_hw_start(struct mmc_queue *mq,
+				   struct mmc_queue_req *mqrq)
+{
+	struct request *prq;
+
+	if (mq->card->host->areq != &mqrq->mmc_active)
+		return;
+
+	if (mqrq->packed_cmd != MMC_PACKED_NONE)
+		list_for_each_entry(prq, &mqrq->packed_list, queuelist)
+			trace_block_rq_hw_start(mq->queue, prq);
+	else
+		trace_block_rq_hw_start(mq->queue, mqrq->req);
+}
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
-			if (rq_data_dir(req) == READ) {
+/*
+ * Starts rqc, if any, and completes the request the host was working on
+ * before, so that rqc is transferred while the block layer is asked for
+ * the next one. With rqc == NULL only the request in flight is completed.
+ *
+ * mmc_start_req() does not start rqc unless the previous request fully
+ * succeeded; the error paths below start it themselves.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mq->mqrq_cur->brq;
+	int ret = 1, disable_multi = 0;
+	enum mmc_blk_status status;
+	struct mmc_queue_req *mq_rq;
+	struct request *req;
+	struct mmc_async_req *areq;
+
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
+
+	if (rqc)
+		mmc_blk_prep_packed_list(mq, rqc);
+
+	do {
+		if (rqc) {
+			mmc_blk_rw_rq_prep_any(mq->mqrq_cur, card, mq);
+			areq = &mq->mqrq_cur->mmc_active;
+		} else
+			areq = NULL;
+		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (rqc)
+			mmc_blk_trace_hw_start(mq, mq->mqrq_cur);
+		if (!areq)
+			return 0;
+
+		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+		brq = &mq_rq->brq;
+		req = mq_rq->req;
+		mmc_queue_bounce_post(mq, mq_rq);
+
+		switch (status) {
+		case MMC_BLK_SUCCESS:
+		case MMC_BLK_PARTIAL:
+			/*
+			 * A block was successfully transferred.
+			 */
+			disable_multi = 0;
+			if (mq_rq->packed_cmd != MMC_PACKED_NONE) {
+				ret = mmc_blk_end_packed_req(mq, mq_rq);
+				req = mq_rq->req;
+				break;
+			}
+			if (brq->data.bytes_xfered == blk_rq_bytes(req)) {
+				mmc_blk_complete_rq(req);
+				ret = 0;
+				break;
+			}
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, 0,
+						brq->data.bytes_xfered);
+			spin_unlock_irq(&md->lock);
+			if (status == MMC_BLK_SUCCESS && ret) {
 				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
+				 * The whole request was transferred, yet
+				 * the block layer wants more: rqc has been
+				 * started already, so just fail the rest.
 				 */
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
-				spin_unlock_irq(&md->lock);
-				continue;
+				printk(KERN_ERR "%s BUG rq_tot %d d_xfer %d\n",
+				       __func__, blk_rq_bytes(req),
+				       brq->data.bytes_xfered);
+				rqc = NULL;
+				goto cmd_abort;
 			}
+			break;
+		case MMC_BLK_CMD_ERR:
 			goto cmd_err;
+		case MMC_BLK_RETRY_SINGLE:
+			disable_multi = 1;
+			break;
+		case MMC_BLK_DATA_ERR:
+			/*
+			 * After an error, we redo I/O one sector at a
+			 * time, so we only reach here after trying to
+			 * read a single sector.
+			 */
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, -EIO, brq->data.blksz);
+			spin_unlock_irq(&md->lock);
+			if (!ret)
+				goto start_new_req;
+			break;
+		case MMC_BLK_NOMEDIUM:
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, -ENODEV,
+					brq->data.blksz * brq->data.blocks);
+			spin_unlock_irq(&md->lock);
+			if (!ret)
+				goto start_new_req;
+			break;
 		}
 
-		/*
-		 * A block was successfully transferred.
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
+		if (ret) {
+			/*
+			 * In case of a incomplete request
+			 * prepare it again and resend.
+			 */
+			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+			mmc_blk_trace_hw_start(mq, mq_rq);
+		}
 	} while (ret);
 
-	if (brq.cmd.resp[0] & R1_URGENT_BKOPS)
-		mmc_card_set_need_bkops(card);
-
-	mmc_release_host(card->host);
-
 	return 1;
 
  cmd_err:
@@ -598,17 +1014,23 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
-	mmc_release_host(card->host);
-
+ cmd_abort:
 	spin_lock_irq(&md->lock);
 	while (ret)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
 	spin_unlock_irq(&md->lock);
 
+ start_new_req:
+	if (rqc) {
+		mmc_blk_rw_rq_prep_any(mq->mqrq_cur, card, mq);
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+		mmc_blk_trace_hw_start(mq, mq->mqrq_cur);
+	}
+
 	return 0;
 }
 
@@ -617,28 +1039,208 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card);
 
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	int ret;
 
-	if (mmc_bus_needs_resume(card->host)) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+	if (req && mmc_bus_needs_resume(card->host)) {
 		mmc_resume_bus(card->host);
 		mmc_blk_set_blksize(md, card);
 	}
 #endif
 
-	if (req->cmd_flags & REQ_DISCARD) {
+	if (req && !mq->mqrq_prev->req) {
+		/* claim host only for the first request */
+		mmc_claim_host(card->host);
+
+		/* Abort any current bk ops of eMMC card by issuing HPI */
+		if (mmc_card_mmc(card) && mmc_card_doing_bkops(card)) {
+			mmc_interrupt_hpi(card);
+			mq->bkops_stats.interrupted++;
+		}
+	}
+
+	if (req && req->cmd_flags & REQ_DISCARD) {
+		/* complete ongoing async transfer before issuing discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		if (req->cmd_flags & REQ_SECURE)
-			return mmc_blk_issue_secdiscard_rq(mq, req);
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
 		else
-			return mmc_blk_issue_discard_rq(mq, req);
+			ret = mmc_blk_issue_discard_rq(mq, req);
+	} else if (req && req->cmd_flags & REQ_FLUSH) {
+		/* the flush must cover the writes still in flight */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		/* Abort any current bk ops of eMMC card by issuing HPI */
-		if (mmc_card_mmc(mq->card) && mmc_card_doing_bkops(mq->card))
-			mmc_interrupt_hpi(mq->card);
+		ret = mmc_blk_issue_rw_rq(mq, req);
+	}
+
+	if (!req)
+		/* release host only when there are no more requests */
+		mmc_release_host(card->host);
+	return ret;
+}
 
-		return mmc_blk_issue_rw_rq(mq, req);
+/*
+ * packed_write turns packing of small writes on and off.  packed_stats
+ * shows how many writes were issued per number of packed requests, 1
+ * being writes issued on their own; writing to it clears the counters.
+ */
+static ssize_t packed_write_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	ssize_t ret;
+
+	if (!md)
+		return -ENODEV;
+	ret = snprintf(buf, PAGE_SIZE, "%d\n", md->queue.packed_write);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_write_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct mmc_blk_data *md;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	md = mmc_blk_get(dev_to_disk(dev));
+	if (!md)
+		return -ENODEV;
+	md->queue.packed_write = !!val;
+	mmc_blk_put(md);
+	return count;
+}
+
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_packed_stats *stats;
+	ssize_t n = 0;
+	int i;
+
+	if (!md)
+		return -ENODEV;
+	stats = &md->queue.packed_stats;
+	n += snprintf(buf + n, PAGE_SIZE - n, "packed  writes\n");
+	for (i = 1; i <= MMC_PACKED_MAX; i++) {
+		if (!stats->packed[i])
+			continue;
+		n += snprintf(buf + n, PAGE_SIZE - n, "%6d  %u\n",
+			      i, stats->packed[i]);
 	}
+	n += snprintf(buf + n, PAGE_SIZE - n, "failed  %u\n", stats->failed);
+	mmc_blk_put(md);
+	return n;
+}
+
+static ssize_t packed_stats_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+
+	if (!md)
+		return -ENODEV;
+	memset(&md->queue.packed_stats, 0, sizeof(struct mmc_packed_stats));
+	mmc_blk_put(md);
+	return count;
+}
+
+static DEVICE_ATTR(packed_write, S_IRUGO | S_IWUSR,
+		   packed_write_show, packed_write_store);
+static DEVICE_ATTR(packed_stats, S_IRUGO | S_IWUSR,
+		   packed_stats_show, packed_stats_store);
+
+static struct attribute *mmc_blk_packed_attrs[] = {
+	&dev_attr_packed_write.attr,
+	&dev_attr_packed_stats.attr,
+	NULL,
+};
+
+static const struct attribute_group mmc_blk_packed_attr_group = {
+	.attrs = mmc_blk_packed_attrs,
+};
+
+/*
+ * bkops_idle_ms is how long the queue has to be idle before background
+ * ops are started, 0 turning that off.  bkops_stats counts background
+ * ops started because the card asked for them, started on an idle
+ * queue, and cut short by a request.
+ */
+static ssize_t bkops_idle_ms_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	ssize_t ret;
+
+	if (!md)
+		return -ENODEV;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.bkops_idle_ms);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t bkops_idle_ms_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct mmc_blk_data *md;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	md = mmc_blk_get(dev_to_disk(dev));
+	if (!md)
+		return -ENODEV;
+	md->queue.bkops_idle_ms = val;
+	mmc_blk_put(md);
+	return count;
+}
+
+static ssize_t bkops_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_bkops_stats *stats;
+	ssize_t ret;
+
+	if (!md)
+		return -ENODEV;
+	stats = &md->queue.bkops_stats;
+	ret = snprintf(buf, PAGE_SIZE, "urgent %u\nidle %u\ninterrupted %u\n",
+		       stats->urgent, stats->idle, stats->interrupted);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static DEVICE_ATTR(bkops_idle_ms, S_IRUGO | S_IWUSR,
+		   bkops_idle_ms_show, bkops_idle_ms_store);
+static DEVICE_ATTR(bkops_stats, S_IRUGO, bkops_stats_show, NULL);
+
+static struct attribute *mmc_blk_bkops_attrs[] = {
+	&dev_attr_bkops_idle_ms.attr,
+	&dev_attr_bkops_stats.attr,
+	NULL,
+};
+
+static const struct attribute_group mmc_blk_bkops_attr_group = {
+	.attrs = mmc_blk_bkops_attrs,
+};
+
+static inline bool mmc_blk_can_pack(struct mmc_blk_data *md)
+{
+	return md->queue.mqrq_cur->packed_cmd_hdr != NULL;
 }
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
@@ -712,6 +1314,10 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 
 	blk_queue_logical_block_size(md->queue.queue, 512);
 
+	/* FUA writes are turned into a write and a flush by the block layer */
+	if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl)
+		blk_queue_flush(md->queue.queue, REQ_FLUSH);
+
 	if (!mmc_card_sd(card) && mmc_card_blockaddr(card)) {
 		/*
 		 * The EXT_CSD sector count is in number or 512 byte
@@ -799,6 +1405,16 @@ static int mmc_blk_probe(struct mmc_card *card)
 	}
 #endif
 	add_disk(md->disk);
+	if (mmc_blk_can_pack(md) &&
+	    sysfs_create_group(&disk_to_dev(md->disk)->kobj,
+			       &mmc_blk_packed_attr_group))
+		printk(KERN_WARNING "%s: unable to create packed write "
+		       "attributes\n", md->disk->disk_name);
+	if (card->ext_csd.bk_ops_en &&
+	    sysfs_create_group(&disk_to_dev(md->disk)->kobj,
+			       &mmc_blk_bkops_attr_group))
+		printk(KERN_WARNING "%s: unable to create bkops "
+		       "attributes\n", md->disk->disk_name);
 	return 0;
 
  out:
@@ -813,6 +1429,13 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		if (mmc_blk_can_pack(md))
+			sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+					   &mmc_blk_packed_attr_group);
+		if (card->ext_csd.bk_ops_en)
+			sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+					   &mmc_blk_bkops_attr_group);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
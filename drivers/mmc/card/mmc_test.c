@@ -1956,6 +1956,332 @@ static int mmc_test_large_seq_write_perf(struct mmc_test_card *test)
 	return mmc_test_large_seq_perf(test, 1);
 }
 
+/**
+ * struct mmc_test_async_req - request issued through mmc_start_req().
+ * @areq: async request handed to the core
+ * @test: test the request belongs to
+ */
+struct mmc_test_async_req {
+	struct mmc_async_req areq;
+	struct mmc_test_card *test;
+};
+
+static int mmc_test_check_result_async(struct mmc_card *card,
+				       struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *test_async =
+		container_of(areq, struct mmc_test_async_req, areq);
+
+	mmc_test_wait_busy(test_async->test);
+
+	return mmc_test_check_result(test_async->test, areq->mrq);
+}
+
+static void mmc_test_nonblock_reset(struct mmc_request *mrq,
+				    struct mmc_command *cmd,
+				    struct mmc_command *stop,
+				    struct mmc_data *data)
+{
+	memset(mrq, 0, sizeof(struct mmc_request));
+	memset(cmd, 0, sizeof(struct mmc_command));
+	memset(data, 0, sizeof(struct mmc_data));
+	memset(stop, 0, sizeof(struct mmc_command));
+
+	mrq->cmd = cmd;
+	mrq->data = data;
+	mrq->stop = stop;
+}
+
+/*
+ * Issue count transfers of the same sg list back to back, preparing each
+ * one while the previous one is still running.
+ */
+static int mmc_test_nonblock_transfer(struct mmc_test_card *test,
+				      struct scatterlist *sg, unsigned sg_len,
+				      unsigned dev_addr, unsigned blocks,
+				      unsigned blksz, int write, int count)
+{
+	struct mmc_request mrq1;
+	struct mmc_command cmd1;
+	struct mmc_command stop1;
+	struct mmc_data data1;
+
+	struct mmc_request mrq2;
+	struct mmc_command cmd2;
+	struct mmc_command stop2;
+	struct mmc_data data2;
+
+	struct mmc_test_async_req test_areq[2];
+	struct mmc_async_req *done_areq;
+	struct mmc_async_req *cur_areq = &test_areq[0].areq;
+	struct mmc_async_req *other_areq = &test_areq[1].areq;
+	int i;
+	int ret = 0;
+
+	test_areq[0].test = test;
+	test_areq[1].test = test;
+
+	mmc_test_nonblock_reset(&mrq1, &cmd1, &stop1, &data1);
+	mmc_test_nonblock_reset(&mrq2, &cmd2, &stop2, &data2);
+
+	cur_areq->mrq = &mrq1;
+	cur_areq->err_check = mmc_test_check_result_async;
+	other_areq->mrq = &mrq2;
+	other_areq->err_check = mmc_test_check_result_async;
+
+	for (i = 0; i < count; i++) {
+		mmc_test_prepare_mrq(test, cur_areq->mrq, sg, sg_len, dev_addr,
+				     blocks, blksz, write);
+		done_areq = mmc_start_req(test->card->host, cur_areq, &ret);
+
+		if (ret || (!done_areq && i > 0))
+			goto err;
+
+		if (done_areq) {
+			if (done_areq->mrq == &mrq2)
+				mmc_test_nonblock_reset(&mrq2, &cmd2,
+							&stop2, &data2);
+			else
+				mmc_test_nonblock_reset(&mrq1, &cmd1,
+							&stop1, &data1);
+		}
+		done_areq = cur_areq;
+		cur_areq = other_areq;
+		other_areq = done_areq;
+		dev_addr += blocks;
+	}
+
+	done_areq = mmc_start_req(test->card->host, NULL, &ret);
+
+	return ret;
+err:
+	/* let the request still in flight, if any, finish */
+	mmc_start_req(test->card->host, NULL, &i);
+	return ret ? ret : RESULT_FAIL;
+}
+
+/*
+ * Sequential transfer of the whole test area in maximum sized requests,
+ * either waiting for each request or pipelining them.
+ */
+static int mmc_test_seq_nonblock_perf(struct mmc_test_card *test, int write,
+				      int nonblock)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int dev_addr, i, cnt, sz, ssz;
+	struct timespec ts1, ts2;
+	int ret;
+
+	sz = t->max_tfr;
+	ssz = sz >> 9;
+	cnt = t->max_sz / sz;
+	dev_addr = t->dev_addr;
+
+	ret = mmc_test_area_map(test, sz, 0);
+	if (ret)
+		return ret;
+
+	getnstimeofday(&ts1);
+	if (nonblock) {
+		ret = mmc_test_nonblock_transfer(test, t->sg, t->sg_len,
+						 dev_addr, t->blocks, 512,
+						 write, cnt);
+	} else {
+		for (i = 0; i < cnt && !ret; i++) {
+			ret = mmc_test_area_transfer(test, dev_addr, write);
+			dev_addr += ssz;
+		}
+	}
+	if (ret)
+		return ret;
+	getnstimeofday(&ts2);
+
+	mmc_test_print_avg_rate(test, sz, cnt, &ts1, &ts2);
+
+	return 0;
+}
+
+static int mmc_test_profile_seq_write_blocking_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_nonblock_perf(test, 1, 0);
+}
+
+static int mmc_test_profile_seq_write_nonblock_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_nonblock_perf(test, 1, 1);
+}
+
+static int mmc_test_profile_seq_read_blocking_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_nonblock_perf(test, 0, 0);
+}
+
+static int mmc_test_profile_seq_read_nonblock_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_nonblock_perf(test, 0, 1);
+}
+
+#define MMC_TEST_PACKED_SZ	4096
+/* entries which fit in the packed command header */
+#define MMC_TEST_PACKED_MAX	((MMC_PACKED_HDR_SIZE / 4 - 2) / 2)
+
+/*
+ * Write nr scattered 4KiB chunks of the mapped test area with one packed
+ * write command.
+ */
+static int mmc_test_packed_write(struct mmc_test_card *test, __le32 *hdr,
+				 struct scatterlist *psg, unsigned int dev_addr,
+				 unsigned int nr)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_card *card = test->card;
+	unsigned int ssz = MMC_TEST_PACKED_SZ >> 9;
+	struct mmc_request mrq;
+	struct mmc_command sbc;
+	struct mmc_command cmd;
+	struct mmc_command stop;
+	struct mmc_data data;
+	unsigned int i, addr;
+	int ret;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+	hdr[0] = cpu_to_le32((nr << 16) | (MMC_PACKED_CMD_WR << 8) |
+			     MMC_PACKED_CMD_VER);
+	for (i = 0; i < nr; i++) {
+		addr = dev_addr + i * 2 * ssz;
+		if (!mmc_card_blockaddr(card))
+			addr <<= 9;
+		hdr[(i + 1) * 2] = cpu_to_le32(ssz);
+		hdr[(i + 1) * 2 + 1] = cpu_to_le32(addr);
+	}
+
+	sg_init_table(psg, t->sg_len + 1);
+	sg_set_buf(&psg[0], hdr, MMC_PACKED_HDR_SIZE);
+	for (i = 0; i < t->sg_len; i++)
+		sg_set_page(&psg[i + 1], sg_page(&t->sg[i]), t->sg[i].length,
+			    t->sg[i].offset);
+
+	memset(&mrq, 0, sizeof(struct mmc_request));
+	memset(&sbc, 0, sizeof(struct mmc_command));
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	memset(&stop, 0, sizeof(struct mmc_command));
+	memset(&data, 0, sizeof(struct mmc_data));
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mrq.stop = &stop;
+
+	sbc.opcode = MMC_SET_BLOCK_COUNT;
+	sbc.arg = MMC_CMD23_ARG_PACKED | (nr * ssz + 1);
+	sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	cmd.arg = dev_addr;
+	if (!mmc_card_blockaddr(card))
+		cmd.arg <<= 9;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	stop.opcode = MMC_STOP_TRANSMISSION;
+	stop.flags = MMC_RSP_R1B | MMC_CMD_AC;
+
+	data.blksz = 512;
+	data.blocks = nr * ssz + 1;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = psg;
+	data.sg_len = t->sg_len + 1;
+	mmc_set_data_timeout(&data, card);
+
+	mmc_wait_for_req(card->host, &mrq);
+
+	mmc_test_wait_busy(test);
+
+	ret = sbc.error;
+	if (!ret)
+		ret = mmc_test_check_result(test, &mrq);
+	return ret;
+}
+
+/*
+ * Small random-ish writes: 4KiB chunks spaced 8KiB apart over the test
+ * area, written one command each or packed into as few commands as the
+ * card and host allow. The rates are per 4KiB write in both cases.
+ */
+static int mmc_test_packed_write_perf(struct mmc_test_card *test, int packed)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_card *card = test->card;
+	unsigned int sz = MMC_TEST_PACKED_SZ, ssz = sz >> 9;
+	unsigned int nr, cnt, i, dev_addr;
+	struct scatterlist *psg = NULL;
+	__le32 *hdr = NULL;
+	struct timespec ts1, ts2;
+	int ret;
+
+	nr = 1;
+	if (packed) {
+		if (!(card->host->caps & MMC_CAP_PACKED_WR))
+			return RESULT_UNSUP_HOST;
+		if (!card->ext_csd.max_packed_writes)
+			return RESULT_UNSUP_CARD;
+
+		nr = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			   MMC_TEST_PACKED_MAX);
+		while (nr > 1 && nr * sz + 512 > t->max_tfr)
+			nr--;
+	}
+
+	cnt = t->max_sz / (2 * sz) / nr * nr;
+	if (!cnt)
+		return RESULT_FAIL;
+
+	ret = mmc_test_area_map(test, nr * sz, 0);
+	if (ret)
+		return ret;
+
+	if (packed) {
+		if (t->sg_len + 1 > t->max_segs)
+			return RESULT_UNSUP_HOST;
+		hdr = kmalloc(MMC_PACKED_HDR_SIZE, GFP_KERNEL);
+		psg = kmalloc(sizeof(struct scatterlist) * (t->sg_len + 1),
+			      GFP_KERNEL);
+		if (!hdr || !psg) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	dev_addr = t->dev_addr;
+	getnstimeofday(&ts1);
+	for (i = 0; i < cnt; i += nr) {
+		if (packed)
+			ret = mmc_test_packed_write(test, hdr, psg, dev_addr,
+						    nr);
+		else
+			ret = mmc_test_area_transfer(test, dev_addr, 1);
+		if (ret)
+			goto out;
+		dev_addr += nr * 2 * ssz;
+	}
+	getnstimeofday(&ts2);
+
+	mmc_test_print_avg_rate(test, sz, cnt, &ts1, &ts2);
+out:
+	kfree(psg);
+	kfree(hdr);
+	return ret;
+}
+
+static int mmc_test_small_write_unpacked_perf(struct mmc_test_card *test)
+{
+	return mmc_test_packed_write_perf(test, 0);
+}
+
+static int mmc_test_small_write_packed_perf(struct mmc_test_card *test)
+{
+	return mmc_test_packed_write_perf(test, 1);
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -2223,6 +2549,48 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.cleanup = mmc_test_area_cleanup,
 	},
 
+	{
+		.name = "Sequential write performance, blocking requests",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_seq_write_blocking_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance, non-blocking requests",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_seq_write_nonblock_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance, blocking requests",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_seq_read_blocking_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance, non-blocking requests",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_seq_read_nonblock_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Small write performance, one command per write",
+		.prepare = mmc_test_area_prepare_erase,
+		.run = mmc_test_small_write_unpacked_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Small write performance, packed writes",
+		.prepare = mmc_test_area_prepare_erase,
+		.run = mmc_test_small_write_packed_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -18,6 +18,7 @@
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
 #include "queue.h"
 
 #define MMC_QUEUE_BOUNCESZ	65536
@@ -52,20 +53,40 @@ static int mmc_queue_thread(void *d)
 	down(&mq->thread_sem);
 	do {
 		struct request *req = NULL;
+		struct mmc_queue_req *tmp;
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
 		req = blk_fetch_request(q);
-		mq->req = req;
+		mq->mqrq_cur->req = req;
 		spin_unlock_irq(q->queue_lock);
 
-		if (!req) {
+		if (req || mq->mqrq_prev->req) {
+			/*
+			 * Issue the new request, or with req == NULL just
+			 * complete the one still in flight.
+			 */
+			set_current_state(TASK_RUNNING);
+			mq->issue_fn(mq, req);
+		} else {
 			/*
 			 * Since the queue is empty, start synchronous
 			 * background ops if there is a request for it.
+			 * Otherwise let the card clean up in the background
+			 * once the queue has stayed idle for a while; only
+			 * if HPI can interrupt that for the next request.
 			 */
-			if (mmc_card_need_bkops(mq->card))
-				mmc_bkops_start(mq->card, true);
+			if (mmc_card_need_bkops(mq->card)) {
+				if (!mmc_bkops_start(mq->card, true))
+					mq->bkops_stats.urgent++;
+			} else if (mq->card->ext_csd.bk_ops_en &&
+				   mq->card->ext_csd.hpi_en &&
+				   mq->bkops_idle_ms &&
+				   !mmc_card_doing_bkops(mq->card)) {
+				mq->idle_since = jiffies;
+				schedule_delayed_work(&mq->bkops_work,
+					msecs_to_jiffies(mq->bkops_idle_ms));
+			}
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
 				break;
@@ -73,16 +94,74 @@ static int mmc_queue_thread(void *d)
 			up(&mq->thread_sem);
 			schedule();
 			down(&mq->thread_sem);
-			continue;
 		}
-		set_current_state(TASK_RUNNING);
-		mq->issue_fn(mq, req);
+
+		/* Current request becomes previous request and vice versa. */
+		mq->mqrq_prev->brq.mrq.data = NULL;
+		mq->mqrq_prev->req = NULL;
+		tmp = mq->mqrq_prev;
+		mq->mqrq_prev = mq->mqrq_cur;
+		mq->mqrq_cur = tmp;
 	} while (1);
 	up(&mq->thread_sem);
 
 	return 0;
 }
 
+/*
+ * True if no request is queued, sorted by the elevator or fetched by
+ * the queue thread.  Called with the queue lock held.
+ */
+static bool mmc_queue_idle(struct mmc_queue *mq)
+{
+	return !mq->mqrq_cur->req && !mq->mqrq_prev->req &&
+	       list_empty(&mq->queue->queue_head) && !mq->queue->nr_sorted;
+}
+
+/*
+ * Starts background ops when the queue has not seen a request for
+ * bkops_idle_ms and the card reports that it has something to do.
+ * They run until the next request interrupts them with HPI.
+ */
+static void mmc_queue_bkops_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    bkops_work.work);
+	struct mmc_host *host = mq->card->host;
+	unsigned long idle_end;
+	bool idle;
+	u8 level;
+
+	if (mq->mqrq_cur->req || mq->mqrq_prev->req ||
+	    !mq->card->ext_csd.hpi_en ||
+	    mmc_bus_needs_resume(mq->card->host))
+		return;
+
+	idle_end = mq->idle_since + msecs_to_jiffies(mq->bkops_idle_ms);
+	if (time_before(jiffies, idle_end)) {
+		schedule_delayed_work(&mq->bkops_work, idle_end - jiffies);
+		return;
+	}
+
+	/*
+	 * The queue thread holds the host while it has requests in
+	 * flight.  Once we hold it, check again that nothing arrived
+	 * meanwhile: a new request would have to interrupt the ops.
+	 */
+	mmc_claim_host(host);
+	if (mmc_read_bkops_status(mq->card, &level) || !level)
+		goto out;
+
+	spin_lock_irq(mq->queue->queue_lock);
+	idle = mmc_queue_idle(mq);
+	spin_unlock_irq(mq->queue->queue_lock);
+
+	if (idle && !mmc_bkops_start(mq->card, false))
+		mq->bkops_stats.idle++;
+out:
+	mmc_release_host(host);
+}
+
 /*
  * Generic MMC request handler.  This is called for any queue on a
  * particular host.  When the host is not busy, we look for a request
@@ -102,10 +181,40 @@ static void mmc_request(struct request_queue *q)
 		return;
 	}
 
-	if (!mq->req)
+	if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);
 }
 
+/*
+ * Completes, from the block softirq, the requests mmcqd handed over with
+ * blk_complete_request().
+ */
+static void mmc_queue_softirq_done(struct request *req)
+{
+	blk_end_request_all(req, req->errors);
+}
+
+static void mmc_queue_free_reqs(struct mmc_queue *mq)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+		kfree(mqrq->bounce_sg);
+		mqrq->bounce_sg = NULL;
+
+		kfree(mqrq->sg);
+		mqrq->sg = NULL;
+
+		kfree(mqrq->bounce_buf);
+		mqrq->bounce_buf = NULL;
+
+		kfree(mqrq->packed_cmd_hdr);
+		mqrq->packed_cmd_hdr = NULL;
+	}
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -119,6 +228,7 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	struct mmc_host *host = card->host;
 	u64 limit = BLK_BOUNCE_HIGH;
 	int ret;
+	int i;
 
 	if (mmc_dev(host)->dma_mask && *mmc_dev(host)->dma_mask)
 		limit = *mmc_dev(host)->dma_mask;
@@ -128,10 +238,18 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	if (!mq->queue)
 		return -ENOMEM;
 
+	memset(&mq->mqrq, 0, sizeof(mq->mqrq));
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++)
+		INIT_LIST_HEAD(&mq->mqrq[i].packed_list);
+	mq->mqrq_cur = &mq->mqrq[0];
+	mq->mqrq_prev = &mq->mqrq[1];
 	mq->queue->queuedata = mq;
-	mq->req = NULL;
+
+	INIT_DELAYED_WORK(&mq->bkops_work, mmc_queue_bkops_work);
+	mq->bkops_idle_ms = MMC_BKOPS_IDLE_MS;
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
+	blk_queue_softirq_done(mq->queue, mmc_queue_softirq_done);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	if (mmc_can_erase(card)) {
 		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, mq->queue);
@@ -149,6 +267,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 						mq->queue);
 	}
 
+	/* lets file systems lay out their allocations in erase blocks */
+	if (card->pref_erase && is_power_of_2(card->pref_erase))
+		blk_queue_io_opt(mq->queue, card->pref_erase << 9);
+
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
 	if (host->max_segs == 1) {
 		unsigned int bouncesz;
@@ -163,53 +285,87 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 			bouncesz = host->max_blk_count * 512;
 
 		if (bouncesz > 512) {
-			mq->bounce_buf = kmalloc(bouncesz, GFP_KERNEL);
-			if (!mq->bounce_buf) {
+			for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+				mq->mqrq[i].bounce_buf =
+					kmalloc(bouncesz, GFP_KERNEL);
+				if (!mq->mqrq[i].bounce_buf)
+					break;
+			}
+			if (i < ARRAY_SIZE(mq->mqrq)) {
 				printk(KERN_WARNING "%s: unable to "
 					"allocate bounce buffer\n",
 					mmc_card_name(card));
+				for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+					kfree(mq->mqrq[i].bounce_buf);
+					mq->mqrq[i].bounce_buf = NULL;
+				}
 			}
 		}
 
-		if (mq->bounce_buf) {
+		if (mq->mqrq_cur->bounce_buf) {
 			blk_queue_bounce_limit(mq->queue, BLK_BOUNCE_ANY);
 			blk_queue_max_hw_sectors(mq->queue, bouncesz / 512);
 			blk_queue_max_segments(mq->queue, bouncesz / 512);
 			blk_queue_max_segment_size(mq->queue, bouncesz);
 
-			mq->sg = kmalloc(sizeof(struct scatterlist),
-				GFP_KERNEL);
-			if (!mq->sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
-			}
-			sg_init_table(mq->sg, 1);
-
-			mq->bounce_sg = kmalloc(sizeof(struct scatterlist) *
-				bouncesz / 512, GFP_KERNEL);
-			if (!mq->bounce_sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
+			for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+				struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+				mqrq->sg = kmalloc(sizeof(struct scatterlist),
+					GFP_KERNEL);
+				if (!mqrq->sg) {
+					ret = -ENOMEM;
+					goto cleanup_queue;
+				}
+				sg_init_table(mqrq->sg, 1);
+
+				mqrq->bounce_sg =
+					kmalloc(sizeof(struct scatterlist) *
+						bouncesz / 512, GFP_KERNEL);
+				if (!mqrq->bounce_sg) {
+					ret = -ENOMEM;
+					goto cleanup_queue;
+				}
+				sg_init_table(mqrq->bounce_sg, bouncesz / 512);
 			}
-			sg_init_table(mq->bounce_sg, bouncesz / 512);
 		}
 	}
 #endif
 
-	if (!mq->bounce_buf) {
+	if (!mq->mqrq_cur->bounce_buf) {
 		blk_queue_bounce_limit(mq->queue, limit);
 		blk_queue_max_hw_sectors(mq->queue,
 			min(host->max_blk_count, host->max_req_size / 512));
 		blk_queue_max_segments(mq->queue, host->max_segs);
 		blk_queue_max_segment_size(mq->queue, host->max_seg_size);
 
-		mq->sg = kmalloc(sizeof(struct scatterlist) *
-			host->max_segs, GFP_KERNEL);
-		if (!mq->sg) {
-			ret = -ENOMEM;
-			goto cleanup_queue;
+		for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+			struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+			mqrq->sg = kmalloc(sizeof(struct scatterlist) *
+				host->max_segs, GFP_KERNEL);
+			if (!mqrq->sg) {
+				ret = -ENOMEM;
+				goto cleanup_queue;
+			}
+			sg_init_table(mqrq->sg, host->max_segs);
+		}
+
+		/* packed writes need one more segment for the header */
+		if (mmc_card_mmc(card) && card->ext_csd.packed_event_en &&
+		    host->max_segs > 1) {
+			for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+				struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+				mqrq->packed_cmd_hdr =
+					kzalloc(MMC_PACKED_HDR_SIZE, GFP_KERNEL);
+				if (!mqrq->packed_cmd_hdr) {
+					ret = -ENOMEM;
+					goto cleanup_queue;
+				}
+			}
+			mq->packed_write = true;
 		}
-		sg_init_table(mq->sg, host->max_segs);
 	}
 
 	sema_init(&mq->thread_sem, 1);
@@ -219,21 +375,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 
 	if (IS_ERR(mq->thread)) {
 		ret = PTR_ERR(mq->thread);
-		goto free_bounce_sg;
+		goto cleanup_queue;
 	}
 
 	return 0;
- free_bounce_sg:
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
  cleanup_queue:
- 	if (mq->sg)
-		kfree(mq->sg);
-	mq->sg = NULL;
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_reqs(mq);
 	blk_cleanup_queue(mq->queue);
 	return ret;
 }
@@ -248,6 +395,7 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
+	cancel_delayed_work_sync(&mq->bkops_work);
 
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
@@ -255,16 +403,7 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	blk_start_queue(q);
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
-
-	kfree(mq->sg);
-	mq->sg = NULL;
-
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_reqs(mq);
 
 	mq->card = NULL;
 }
@@ -291,6 +430,7 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 		spin_unlock_irqrestore(q->queue_lock, flags);
 
 		down(&mq->thread_sem);
+		cancel_delayed_work_sync(&mq->bkops_work);
 	}
 }
 
@@ -314,30 +454,58 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * The header goes first, followed by the data of each packed request.
+ * blk_rq_map_sg() ends every list it maps, so the end mark is moved
+ * past the last request.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_queue_req *mqrq)
+{
+	struct scatterlist *sg = mqrq->sg;
+	struct request *req;
+	unsigned int sg_len;
+
+	sg_set_buf(sg, mqrq->packed_cmd_hdr, MMC_PACKED_HDR_SIZE);
+	sg->page_link &= ~0x02;
+	sg_len = 1;
+
+	list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+		sg_len += blk_rq_map_sg(mq->queue, req, sg + sg_len);
+		sg[sg_len - 1].page_link &= ~0x02;
+	}
+	sg_mark_end(&sg[sg_len - 1]);
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
-unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
+unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	unsigned int sg_len;
 	size_t buflen;
 	struct scatterlist *sg;
 	int i;
 
-	if (!mq->bounce_buf)
-		return blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+	if (mqrq->packed_cmd != MMC_PACKED_NONE)
+		return mmc_queue_packed_map_sg(mq, mqrq);
 
-	BUG_ON(!mq->bounce_sg);
+	if (!mqrq->bounce_buf)
+		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
-	sg_len = blk_rq_map_sg(mq->queue, mq->req, mq->bounce_sg);
+	BUG_ON(!mqrq->bounce_sg);
 
-	mq->bounce_sg_len = sg_len;
+	sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
+
+	mqrq->bounce_sg_len = sg_len;
 
 	buflen = 0;
-	for_each_sg(mq->bounce_sg, sg, sg_len, i)
+	for_each_sg(mqrq->bounce_sg, sg, sg_len, i)
 		buflen += sg->length;
 
-	sg_init_one(mq->sg, mq->bounce_buf, buflen);
+	sg_init_one(mqrq->sg, mqrq->bounce_buf, buflen);
 
 	return 1;
 }
@@ -346,39 +514,42 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
  * If writing, bounce the data to the buffer before the request
  * is sent to the host driver
  */
-void mmc_queue_bounce_pre(struct mmc_queue *mq)
+void mmc_queue_bounce_pre(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_buf)
 		return;
 
-	if (rq_data_dir(mq->req) != WRITE)
+	if (rq_data_dir(mqrq->req) != WRITE)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_to_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_to_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
+
+	atomic64_add(mqrq->sg[0].length, &mq->card->host->bounce_bytes);
 }
 
 /*
  * If reading, bounce the data from the buffer after the request
  * has been handled by the host driver
  */
-void mmc_queue_bounce_post(struct mmc_queue *mq)
+void mmc_queue_bounce_post(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_buf)
 		return;
 
-	if (rq_data_dir(mq->req) != READ)
+	if (rq_data_dir(mqrq->req) != READ)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_from_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_from_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
-}
 
+	atomic64_add(mqrq->sg[0].length, &mq->card->host->bounce_bytes);
+}
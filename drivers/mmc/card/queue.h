@@ -1,22 +1,88 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/mmc/core.h>
+#include <linux/mmc/host.h>
+#include <linux/workqueue.h>
+
 struct request;
 struct task_struct;
 
+struct mmc_blk_request {
+	struct mmc_request	mrq;
+	struct mmc_command	sbc;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+};
+
+enum mmc_packed_cmd {
+	MMC_PACKED_NONE = 0,
+	MMC_PACKED_WRITE,
+};
+
+/* entries which fit in the 512 byte packed command header */
+#define MMC_PACKED_MAX		63
+#define MMC_PACKED_N_IDX	-1	/* no failed entry */
+
+struct mmc_queue_req {
+	struct request		*req;
+	struct mmc_blk_request	brq;
+	struct scatterlist	*sg;
+	char			*bounce_buf;
+	struct scatterlist	*bounce_sg;
+	unsigned int		bounce_sg_len;
+	struct mmc_async_req	mmc_active;
+	/*
+	 * For a packed write, req is the first request of packed_list,
+	 * which the requests are linked into through their queuelist.
+	 */
+	enum mmc_packed_cmd	packed_cmd;
+	struct list_head	packed_list;
+	__le32			*packed_cmd_hdr;
+	unsigned int		packed_blocks;
+	unsigned int		packed_num;
+	int			packed_fail_idx;
+};
+
+struct mmc_packed_stats {
+	/* writes issued by packed size, [1] counting unpacked writes */
+	unsigned int		packed[MMC_PACKED_MAX + 1];
+	unsigned int		failed;		/* rejected by the card */
+};
+
+struct mmc_bkops_stats {
+	unsigned int		urgent;		/* requested by the card */
+	unsigned int		idle;		/* started on an idle queue */
+	unsigned int		interrupted;	/* stopped by HPI for I/O */
+};
+
+/* queue idle time after which background ops are started */
+#define MMC_BKOPS_IDLE_MS	2000
+
 struct mmc_queue {
 	struct mmc_card		*card;
 	struct task_struct	*thread;
 	struct semaphore	thread_sem;
 	unsigned int		flags;
-	struct request		*req;
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
 	void			*data;
 	struct request_queue	*queue;
-	struct scatterlist	*sg;
-	char			*bounce_buf;
-	struct scatterlist	*bounce_sg;
-	unsigned int		bounce_sg_len;
+	/*
+	 * While the host transfers mqrq_prev, the next request is fetched
+	 * and prepared in mqrq_cur; the two are swapped after each issue.
+	 */
+	struct mmc_queue_req	mqrq[2];
+	struct mmc_queue_req	*mqrq_cur;
+	struct mmc_queue_req	*mqrq_prev;
+
+	bool			packed_write;	/* sysfs switch */
+	struct mmc_packed_stats	packed_stats;
+
+	struct delayed_work	bkops_work;
+	unsigned int		bkops_idle_ms;	/* sysfs, 0 disables */
+	unsigned long		idle_since;	/* jiffies */
+	struct mmc_bkops_stats	bkops_stats;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *);
@@ -24,8 +90,10 @@ extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
 
-extern unsigned int mmc_queue_map_sg(struct mmc_queue *);
-extern void mmc_queue_bounce_pre(struct mmc_queue *);
-extern void mmc_queue_bounce_post(struct mmc_queue *);
+extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
+				     struct mmc_queue_req *);
+extern void mmc_queue_bounce_pre(struct mmc_queue *, struct mmc_queue_req *);
+extern void mmc_queue_bounce_post(struct mmc_queue *,
+				  struct mmc_queue_req *);
 
 #endif
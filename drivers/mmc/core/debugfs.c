@@ -9,6 +9,8 @@
  */
 #include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
@@ -161,6 +163,39 @@ static int mmc_clock_opt_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(mmc_clock_fops, mmc_clock_opt_get, mmc_clock_opt_set,
 	"%llu\n");
 
+/* The rate covers the time since the file was last read. */
+static int mmc_bounce_show(struct seq_file *s, void *data)
+{
+	struct mmc_host	*host = s->private;
+	unsigned long now = jiffies;
+	unsigned int ms;
+	u64 bytes, rate = 0;
+
+	bytes = atomic64_read(&host->bounce_bytes);
+	ms = jiffies_to_msecs(now - host->bounce_stamp);
+	if (ms)
+		rate = div_u64((bytes - host->bounce_last) * MSEC_PER_SEC, ms);
+	host->bounce_last = bytes;
+	host->bounce_stamp = now;
+
+	seq_printf(s, "bytes:\t\t%llu\n", bytes);
+	seq_printf(s, "bytes/sec:\t%llu\n", rate);
+
+	return 0;
+}
+
+static int mmc_bounce_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_bounce_show, inode->i_private);
+}
+
+static const struct file_operations mmc_bounce_fops = {
+	.open		= mmc_bounce_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -183,6 +218,11 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 			&mmc_clock_fops))
 		goto err_node;
 
+	host->bounce_stamp = jiffies;
+	if (!debugfs_create_file("bounce", S_IRUSR, root, host,
+			&mmc_bounce_fops))
+		goto err_node;
+
 #ifdef CONFIG_MMC_CLKGATE
 	if (!debugfs_create_u32("clk_delay", (S_IRUSR | S_IWUSR),
 				root, &host->clk_delay))
@@ -464,6 +464,17 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			card->ext_csd.bk_ops = 1;
 	}
 
+	/* eMMC 4.5 packed commands and volatile cache */
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+	}
+
 	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
 		card->erased_byte = 0xFF;
 	else
@@ -802,6 +813,46 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Have the card report failed packed commands, so that the block
+	 * driver can tell which of the packed requests went through.
+	 */
+	if (card->ext_csd.max_packed_writes &&
+	    (card->host->caps & MMC_CAP_PACKED_WR)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_EXP_EVENTS_CTRL, EXT_CSD_PACKED_EVENT_EN);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		if (err) {
+			pr_warning("%s: Enabling packed event failed\n",
+				   mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.packed_event_en = 1;
+		}
+	}
+
+	/*
+	 * Enable the volatile cache (if supported).  Writes are then only
+	 * guaranteed to be on flash after a cache flush, which the block
+	 * driver issues for REQ_FLUSH.
+	 */
+	if (card->ext_csd.cache_size &&
+	    (card->host->caps & MMC_CAP_CACHE_CTRL)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_CACHE_CTRL, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		if (err) {
+			pr_warning("%s: Enabling cache failed\n",
+				   mmc_hostname(card->host));
+			card->ext_csd.cache_ctrl = 0;
+			err = 0;
+		} else {
+			card->ext_csd.cache_ctrl = 1;
+		}
+	}
+
 	/*
 	 * Compute bus speed.
 	 */
@@ -352,6 +352,7 @@ int mmc_send_ext_csd(struct mmc_card *card, u8 *ext_csd)
 	return mmc_send_cxd_data(card, card->host, MMC_SEND_EXT_CSD,
 			ext_csd, 512);
 }
+EXPORT_SYMBOL(mmc_send_ext_csd);
 
 int mmc_spi_read_ocr(struct mmc_host *host, int highcap, u32 *ocrp)
 {
@@ -615,7 +616,7 @@ int mmc_send_bk_ops_cmd(struct mmc_card *card, bool is_synchronous)
 
 	cmd.opcode = MMC_SWITCH;
 	cmd.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
-		(EXT_CSD_BKOPS_EN << 16) |
+		(EXT_CSD_BKOPS_START << 16) |
 		(1 << 8) |
 		EXT_CSD_CMD_SET_NORMAL;
 	if (is_synchronous)
@@ -627,13 +628,19 @@ int mmc_send_bk_ops_cmd(struct mmc_card *card, bool is_synchronous)
 	if (err)
 		return err;
 
-	/* Must check status to be sure of no errors */
+	/*
+	 * Must check status to be sure of no errors.  Background ops
+	 * started asynchronously keep the card in prg-state until they
+	 * finish or are interrupted by HPI, so don't wait for that.
+	 */
 	do {
 		err = mmc_send_status(card, &status);
 		if (err)
 			return err;
 		if (card->host->caps & MMC_CAP_WAIT_WHILE_BUSY)
 			break;
+		if (!is_synchronous)
+			break;
 	} while (R1_CURRENT_STATE(status) == 7);
 
 	if (status & 0xFDFFA000)
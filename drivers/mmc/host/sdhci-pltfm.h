@@ -37,6 +37,17 @@ struct tegra_sdhci_host {
 	struct tegra_io_dpd *dpd;
 	bool card_present;
 	bool is_rail_enabled;
+	/* result of the last full tuning, reused while the card stays */
+	bool tuning_valid;
+	u32 tuning_cid[4];
+	unsigned int tuning_clock;
+	u16 tuning_uhs;
+	unsigned int tuning_tap;
+	/* tuning statistics */
+	unsigned int tuning_hits;
+	unsigned int tuning_full;
+	u32 tuning_last_us;
+	u64 tuning_total_us;
 };
 
 extern struct sdhci_pltfm_data sdhci_cns3xxx_pdata;
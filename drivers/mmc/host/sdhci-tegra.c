@@ -18,8 +18,10 @@
 #include <linux/init.h>
 #include <linux/platform_device.h>
 #include <linux/clk.h>
+#include <linux/dma-mapping.h>
 #include <linux/io.h>
 #include <linux/gpio.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -737,24 +739,81 @@ out:
 	return err;
 }
 
+/*
+ * The tap value found by a full tuning is kept together with the CID of
+ * the card, the clock and the UHS mode it was found for. When the same
+ * card is tuned again (on resume or re-init), the cached tap is checked
+ * with a single CMD19 and the full sweep is only run if that fails.
+ */
+static bool sdhci_tegra_tuning_cached(struct sdhci_host *sdhci, u16 uhs)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
+	struct mmc_card *card = sdhci->mmc->card;
+
+	if (!tegra_host->tuning_valid || !card)
+		return false;
+
+	if (memcmp(tegra_host->tuning_cid, card->raw_cid,
+		   sizeof(tegra_host->tuning_cid)))
+		return false;
+
+	return tegra_host->tuning_clock == sdhci->mmc->ios.clock &&
+		tegra_host->tuning_uhs == uhs;
+}
+
+/* Records the card the current tuning belongs to. */
+static void sdhci_tegra_tuning_stamp(struct sdhci_host *sdhci)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
+	struct mmc_card *card = sdhci->mmc->card;
+
+	if (tegra_host->tuning_valid && card)
+		memcpy(tegra_host->tuning_cid, card->raw_cid,
+		       sizeof(tegra_host->tuning_cid));
+}
+
 static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci)
 {
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
 	int err;
 	u16 ctrl_2;
-	u8 *tap_delay_status;
+	u16 uhs;
+	u8 *tap_delay_status = NULL;
 	unsigned int i = 0;
 	unsigned int temp_low_pass_tap = 0;
 	unsigned int temp_pass_window = 0;
 	unsigned int best_low_pass_tap = 0;
 	unsigned int best_pass_window = 0;
+	unsigned int tap;
+	ktime_t start;
 
 	/* Tuning is valid only in SDR104 and SDR50 modes */
 	ctrl_2 = sdhci_readw(sdhci, SDHCI_HOST_CONTROL2);
-	if (!(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR104) ||
-		(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR50) &&
+	uhs = ctrl_2 & SDHCI_CTRL_UHS_MASK;
+	if (!((uhs == SDHCI_CTRL_UHS_SDR104) ||
+		((uhs == SDHCI_CTRL_UHS_SDR50) &&
 		(sdhci->flags & SDHCI_SDR50_NEEDS_TUNING))))
 			return 0;
 
+	start = ktime_get();
+
+	if (sdhci_tegra_tuning_cached(sdhci, uhs)) {
+		sdhci_tegra_set_tap_delay(sdhci, tegra_host->tuning_tap);
+		err = sdhci_tegra_run_frequency_tuning(sdhci);
+		if (!err) {
+			tegra_host->tuning_hits++;
+			goto out;
+		}
+		dev_dbg(mmc_dev(sdhci->mmc), "cached tap %u failed, "
+			"retuning\n", tegra_host->tuning_tap);
+	}
+
+	tegra_host->tuning_valid = false;
+	tegra_host->tuning_full++;
+
 	tap_delay_status = kzalloc(MAX_TAP_VALUES, GFP_KERNEL);
 	if (tap_delay_status == NULL) {
 		dev_err(mmc_dev(sdhci->mmc), "failed to allocate memory"
@@ -808,19 +867,58 @@ static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci)
 		(best_low_pass_tap + best_pass_window));
 
 	/* Set the best tap */
-	sdhci_tegra_set_tap_delay(sdhci,
-		(best_low_pass_tap + ((best_pass_window * 3) / 4)));
+	tap = best_low_pass_tap + ((best_pass_window * 3) / 4);
+	sdhci_tegra_set_tap_delay(sdhci, tap);
 
 	/* Run frequency tuning */
 	err = sdhci_tegra_run_frequency_tuning(sdhci);
 
+	if (!err) {
+		tegra_host->tuning_valid = true;
+		tegra_host->tuning_tap = tap;
+		tegra_host->tuning_clock = sdhci->mmc->ios.clock;
+		tegra_host->tuning_uhs = uhs;
+		memset(tegra_host->tuning_cid, 0,
+		       sizeof(tegra_host->tuning_cid));
+		sdhci_tegra_tuning_stamp(sdhci);
+	}
+
 out:
 	if (tap_delay_status)
 		kfree(tap_delay_status);
 
+	tegra_host->tuning_last_us = ktime_to_us(ktime_sub(ktime_get(), start));
+	tegra_host->tuning_total_us += tegra_host->tuning_last_us;
+
 	return err;
 }
 
+/*
+ * tuning_stats: tunings served from the cache, full tunings, length of
+ * the last tuning and total time spent tuning (both in us).
+ */
+static ssize_t show_tuning_stats(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct sdhci_host *sdhci = dev_get_drvdata(dev);
+	struct sdhci_pltfm_host *pltfm_host;
+	struct tegra_sdhci_host *tegra_host;
+
+	/* the driver data is set once the host has been added */
+	if (!sdhci)
+		return -ENODEV;
+	pltfm_host = sdhci_priv(sdhci);
+	tegra_host = pltfm_host->priv;
+
+	return sprintf(buf, "%u %u %u %llu\n", tegra_host->tuning_hits,
+		       tegra_host->tuning_full, tegra_host->tuning_last_us,
+		       tegra_host->tuning_total_us);
+}
+
+static DEVICE_ATTR(tuning_stats, S_IRUGO, show_tuning_stats, NULL);
+
+static u64 tegra_sdhci_dma_mask = DMA_BIT_MASK(32);
+
 static int tegra_sdhci_pltfm_init(struct sdhci_host *host,
 				  struct sdhci_pltfm_data *pdata)
 {
@@ -843,6 +941,14 @@ static int tegra_sdhci_pltfm_init(struct sdhci_host *host,
 		return -ENOMEM;
 	}
 
+	/*
+	 * ADMA reaches all of memory and the descriptors can point anywhere,
+	 * highmem pages included. Without a mask the block layer would copy
+	 * every highmem page down to lowmem before handing it to us.
+	 */
+	if (!pdev->dev.dma_mask)
+		pdev->dev.dma_mask = &tegra_sdhci_dma_mask;
+
 #ifdef CONFIG_MMC_EMBEDDED_SDIO
 	if (plat->mmc_data.embedded_sdio)
 		mmc_set_embedded_sdio_data(host->mmc,
@@ -1010,6 +1116,8 @@ static int tegra_sdhci_pltfm_init(struct sdhci_host *host,
 	host->mmc->pm_caps = MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
 	if (plat->mmc_data.built_in) {
 		host->mmc->caps |= MMC_CAP_NONREMOVABLE;
+		host->mmc->caps |= MMC_CAP_PACKED_WR;
+		host->mmc->caps |= MMC_CAP_CACHE_CTRL;
 		host->mmc->pm_flags = MMC_PM_IGNORE_PM_NOTIFY;
 	}
 	/* Do not turn OFF embedded sdio cards as it support Wake on Wireless */
@@ -1025,6 +1133,12 @@ static int tegra_sdhci_pltfm_init(struct sdhci_host *host,
 	tegra_sdhost_std_freq = TEGRA3_SDHOST_STD_FREQ;
 #endif
 
+	if (device_create_file(&pdev->dev, &dev_attr_tuning_stats))
+		dev_warn(mmc_dev(host->mmc), "failed to create tuning_stats\n");
+
+	/* re-initializing the card is slow, and only the card waits for it */
+	device_enable_async_resume(&pdev->dev);
+
 	return 0;
 
 err_clkput:
@@ -1065,6 +1179,8 @@ static void tegra_sdhci_pltfm_exit(struct sdhci_host *host)
 
 	plat = pdev->dev.platform_data;
 
+	device_remove_file(&pdev->dev, &dev_attr_tuning_stats);
+
 	disable_irq_wake(gpio_to_irq(plat->cd_gpio));
 
 	if (tegra_host->vdd_slot_reg) {
@@ -1111,6 +1227,8 @@ static int tegra_sdhci_suspend(struct sdhci_host *sdhci, pm_message_t state)
 	struct tegra_sdhci_platform_data *plat = pdev->dev.platform_data;
 #endif
 
+	sdhci_tegra_tuning_stamp(sdhci);
+
 	tegra_sdhci_set_clock(sdhci, 0);
 
 	/* Disable the power rails if any */
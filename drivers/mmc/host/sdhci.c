@@ -431,6 +431,48 @@ static void sdhci_set_adma_desc(u8 *desc, u32 addr, int len, unsigned cmd)
 	dataddr[0] = cpu_to_le32(addr);
 }
 
+/*
+ * data->host_cookie tells who mapped the scatterlist: sdhci_pre_req()
+ * maps it ahead of the request, while the previous one is transferred,
+ * and sdhci_post_req() unmaps it. Otherwise it is mapped and unmapped
+ * around the transfer itself.
+ */
+enum sdhci_cookie {
+	COOKIE_UNMAPPED,
+	COOKIE_PRE_MAPPED,	/* mapped by sdhci_pre_req() */
+	COOKIE_MAPPED,		/* mapped by sdhci_prepare_data() */
+};
+
+static int sdhci_pre_dma_transfer(struct sdhci_host *host,
+	struct mmc_data *data, enum sdhci_cookie cookie)
+{
+	int sg_count;
+
+	if (data->host_cookie == COOKIE_PRE_MAPPED)
+		return data->sg_count;
+
+	sg_count = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			      (data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	if (sg_count == 0)
+		return 0;
+
+	data->sg_count = sg_count;
+	data->host_cookie = cookie;
+	return sg_count;
+}
+
+static void sdhci_unmap_data(struct sdhci_host *host, struct mmc_data *data)
+{
+	if (data->host_cookie != COOKIE_MAPPED)
+		return;
+
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		     (data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = COOKIE_UNMAPPED;
+}
+
 static int sdhci_adma_table_pre(struct sdhci_host *host,
 	struct mmc_data *data)
 {
@@ -468,8 +510,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		goto fail;
 	BUG_ON(host->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
-		data->sg, data->sg_len, direction);
+	host->sg_count = sdhci_pre_dma_transfer(host, data, COOKIE_MAPPED);
 	if (host->sg_count == 0)
 		goto unmap_align;
 
@@ -493,9 +534,10 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		if (offset) {
 			if (data->flags & MMC_DATA_WRITE) {
 				buffer = sdhci_kmap_atomic(sg, &flags);
-				WARN_ON(((long)buffer & PAGE_MASK) > (PAGE_SIZE - 3));
+				WARN_ON(((long)buffer & ~PAGE_MASK) > (PAGE_SIZE - 3));
 				memcpy(align, buffer, offset);
 				sdhci_kunmap_atomic(buffer, &flags);
+				atomic64_add(offset, &host->mmc->bounce_bytes);
 			}
 
 			/* tran, valid */
@@ -559,8 +601,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	return 0;
 
 unmap_entries:
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	sdhci_unmap_data(host, data);
 unmap_align:
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 		128 * 4, direction);
@@ -601,17 +642,17 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 				size = 4 - (sg_dma_address(sg) & 0x3);
 
 				buffer = sdhci_kmap_atomic(sg, &flags);
-				WARN_ON(((long)buffer & PAGE_MASK) > (PAGE_SIZE - 3));
+				WARN_ON(((long)buffer & ~PAGE_MASK) > (PAGE_SIZE - 3));
 				memcpy(buffer, align, size);
 				sdhci_kunmap_atomic(buffer, &flags);
+				atomic64_add(size, &host->mmc->bounce_bytes);
 
 				align += 4;
 			}
 		}
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	sdhci_unmap_data(host, data);
 }
 
 static u8 sdhci_calc_timeout(struct sdhci_host *host, struct mmc_data *data)
@@ -674,6 +715,70 @@ static void sdhci_set_transfer_irqs(struct sdhci_host *host)
 		sdhci_clear_set_irqs(host, dma_irqs, pio_irqs);
 }
 
+/*
+ * Checks whether the quirks of the controller allow a DMA transfer of
+ * the scatterlist, or whether it has to be done by PIO.
+ */
+static bool sdhci_data_can_dma(struct sdhci_host *host, struct mmc_data *data)
+{
+	struct scatterlist *sg;
+	int broken, i;
+
+	/*
+	 * FIXME: This doesn't account for merging when mapping the
+	 * scatterlist.
+	 */
+	broken = 0;
+	if (host->flags & SDHCI_USE_ADMA) {
+		if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
+			broken = 1;
+	} else {
+		if (host->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE)
+			broken = 1;
+	}
+
+	if (unlikely(broken)) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if (sg->length & 0x3) {
+				DBG("Reverting to PIO because of "
+					"transfer size (%d)\n",
+					sg->length);
+				return false;
+			}
+		}
+	}
+
+	/*
+	 * The assumption here being that alignment is the same after
+	 * translation to device address space.
+	 */
+	broken = 0;
+	if (host->flags & SDHCI_USE_ADMA) {
+		/*
+		 * As we use 3 byte chunks to work around
+		 * alignment problems, we need to check this
+		 * quirk.
+		 */
+		if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
+			broken = 1;
+	} else {
+		if (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR)
+			broken = 1;
+	}
+
+	if (unlikely(broken)) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if (sg->offset & 0x3) {
+				DBG("Reverting to PIO because of "
+					"bad alignment\n");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 {
 	u8 count;
@@ -699,69 +804,9 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 	if (host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA))
 		host->flags |= SDHCI_REQ_USE_DMA;
 
-	/*
-	 * FIXME: This doesn't account for merging when mapping the
-	 * scatterlist.
-	 */
-	if (host->flags & SDHCI_REQ_USE_DMA) {
-		int broken, i;
-		struct scatterlist *sg;
-
-		broken = 0;
-		if (host->flags & SDHCI_USE_ADMA) {
-			if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
-				broken = 1;
-		} else {
-			if (host->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE)
-				broken = 1;
-		}
-
-		if (unlikely(broken)) {
-			for_each_sg(data->sg, sg, data->sg_len, i) {
-				if (sg->length & 0x3) {
-					DBG("Reverting to PIO because of "
-						"transfer size (%d)\n",
-						sg->length);
-					host->flags &= ~SDHCI_REQ_USE_DMA;
-					break;
-				}
-			}
-		}
-	}
-
-	/*
-	 * The assumption here being that alignment is the same after
-	 * translation to device address space.
-	 */
-	if (host->flags & SDHCI_REQ_USE_DMA) {
-		int broken, i;
-		struct scatterlist *sg;
-
-		broken = 0;
-		if (host->flags & SDHCI_USE_ADMA) {
-			/*
-			 * As we use 3 byte chunks to work around
-			 * alignment problems, we need to check this
-			 * quirk.
-			 */
-			if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
-				broken = 1;
-		} else {
-			if (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR)
-				broken = 1;
-		}
-
-		if (unlikely(broken)) {
-			for_each_sg(data->sg, sg, data->sg_len, i) {
-				if (sg->offset & 0x3) {
-					DBG("Reverting to PIO because of "
-						"bad alignment\n");
-					host->flags &= ~SDHCI_REQ_USE_DMA;
-					break;
-				}
-			}
-		}
-	}
+	if ((host->flags & SDHCI_REQ_USE_DMA) &&
+	    !sdhci_data_can_dma(host, data))
+		host->flags &= ~SDHCI_REQ_USE_DMA;
 
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA) {
@@ -780,11 +825,8 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		} else {
 			int sg_cnt;
 
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
-					data->sg, data->sg_len,
-					(data->flags & MMC_DATA_READ) ?
-						DMA_FROM_DEVICE :
-						DMA_TO_DEVICE);
+			sg_cnt = sdhci_pre_dma_transfer(host, data,
+							COOKIE_MAPPED);
 			if (sg_cnt == 0) {
 				/*
 				 * This only happens when someone fed
@@ -819,6 +861,15 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 	if (!(host->flags & SDHCI_REQ_USE_DMA)) {
 		int flags;
 
+		/* the CPU fills the buffer, give it back before it does */
+		if (data->host_cookie == COOKIE_PRE_MAPPED) {
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     (data->flags & MMC_DATA_READ) ?
+					DMA_FROM_DEVICE : DMA_TO_DEVICE);
+			data->host_cookie = COOKIE_UNMAPPED;
+		}
+
 		flags = SG_MITER_ATOMIC;
 		if (host->data->flags & MMC_DATA_READ)
 			flags |= SG_MITER_TO_SG;
@@ -847,7 +898,8 @@ static void sdhci_set_transfer_mode(struct sdhci_host *host,
 
 	mode = SDHCI_TRNS_BLK_CNT_EN;
 	if (data->blocks > 1) {
-		if (host->quirks & SDHCI_QUIRK_MULTIBLOCK_READ_ACMD12)
+		if ((host->quirks & SDHCI_QUIRK_MULTIBLOCK_READ_ACMD12) &&
+		    !host->mrq->sbc)
 			mode |= SDHCI_TRNS_MULTI | SDHCI_TRNS_ACMD12;
 		else
 			mode |= SDHCI_TRNS_MULTI;
@@ -872,11 +924,8 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA)
 			sdhci_adma_table_post(host, data);
-		else {
-			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-				data->sg_len, (data->flags & MMC_DATA_READ) ?
-					DMA_FROM_DEVICE : DMA_TO_DEVICE);
-		}
+		else
+			sdhci_unmap_data(host, data);
 	}
 
 	/*
@@ -891,7 +940,11 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	else
 		data->bytes_xfered = data->blksz * data->blocks;
 
-	if (data->stop) {
+	/*
+	 * A transfer whose length was set by CMD23 ends by itself, it
+	 * only needs a stop command when it failed.
+	 */
+	if (data->stop && (data->error || !host->mrq->sbc)) {
 		/*
 		 * The controller needs a reset of internal state machines
 		 * upon error conditions.
@@ -1002,6 +1055,13 @@ static void sdhci_finish_command(struct sdhci_host *host)
 
 	host->cmd->error = 0;
 
+	/* Finished CMD23, now send the read/write command */
+	if (host->cmd == host->mrq->sbc) {
+		host->cmd = NULL;
+		sdhci_send_command(host, host->mrq->cmd);
+		return;
+	}
+
 	if (host->data && host->data_early)
 		sdhci_finish_data(host);
 
@@ -1184,7 +1244,9 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	if (!present || host->flags & SDHCI_DEVICE_DEAD) {
 		host->mrq->cmd->error = -ENOMEDIUM;
 		tasklet_schedule(&host->finish_tasklet);
-	} else
+	} else if (mrq->sbc)
+		sdhci_send_command(host, mrq->sbc);
+	else
 		sdhci_send_command(host, mrq->cmd);
 
 	mmiowb();
@@ -1716,7 +1778,60 @@ out:
 	return err;
 }
 
+/*
+ * Maps the data of the next request while the current one is running.
+ * Buffers which need the ADMA align bounce or which would fall back to
+ * PIO are left to sdhci_prepare_data(): the bytes copied back by the CPU
+ * would be lost when a deferred unmap invalidates the cache.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct scatterlist *sg;
+	int i;
+
+	if (!data)
+		return;
+
+	data->host_cookie = COOKIE_UNMAPPED;
+
+	if (!(host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA)))
+		return;
+
+	if (!sdhci_data_can_dma(host, data))
+		return;
+
+	if (host->flags & SDHCI_USE_ADMA) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if ((sg->offset & 0x3) || (sg->length & 0x3))
+				return;
+		}
+	}
+
+	sdhci_pre_dma_transfer(host, data, COOKIE_PRE_MAPPED);
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	int err)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
+
+	if (data->host_cookie == COOKIE_PRE_MAPPED)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     (data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = COOKIE_UNMAPPED;
+}
+
 static const struct mmc_host_ops sdhci_ops = {
+	.post_req	= sdhci_post_req,
+	.pre_req	= sdhci_pre_req,
 	.request	= sdhci_request,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
@@ -1819,6 +1934,7 @@ static void sdhci_tasklet_finish(unsigned long param)
 	 */
 	if (!(host->flags & SDHCI_DEVICE_DEAD) &&
 	    ((mrq->cmd && mrq->cmd->error) ||
+	     (mrq->sbc && mrq->sbc->error) ||
 		 (mrq->data && (mrq->data->error ||
 		  (mrq->data->stop && mrq->data->stop->error))) ||
 		   (host->quirks & SDHCI_QUIRK_RESET_AFTER_REQUEST))) {
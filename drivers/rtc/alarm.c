@@ -52,8 +52,7 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define ANDROID_ALARM_SET_AND_WAIT_OLD      _IOW('a', 3, time_t)
 
 struct alarm_queue {
-	struct rb_root alarms;
-	struct rb_node *first;
+	struct timerqueue_head alarms;
 	struct hrtimer timer;
 	ktime_t delta;
 	bool stopped;
@@ -68,8 +67,44 @@ static struct platform_device *alarm_platform_dev;
 struct alarm_queue alarms[ANDROID_ALARM_TYPE_COUNT];
 static bool suspended;
 
+/* rtc time of the wakeup alarm left programmed in the rtc, 0 if none */
+static unsigned long rtc_alarm_programmed;
+
+/*
+ * Wakeups saved: wakeup alarms run early, by a wakeup that was due for an
+ * earlier one, which would have needed a wakeup of their own later.
+ */
+static unsigned int batched_alarms;
+module_param(batched_alarms, uint, S_IRUGO);
+
+/* suspends which found the rtc alarm already programmed */
+static unsigned int rtc_writes_saved;
+module_param(rtc_writes_saved, uint, S_IRUGO);
+
+/*
+ * Alarms following @first whose earliest expiry is no later than the
+ * expiry of @first can all run in one wakeup.  Returns the soft expiry
+ * for the timer which makes all of them due when it fires.
+ */
+static ktime_t alarm_batch_softexpires(struct alarm *first)
+{
+	struct timerqueue_node *next = &first->node;
+	ktime_t soft = first->softexpires;
+
+	while ((next = timerqueue_iterate_next(next))) {
+		struct alarm *alarm = container_of(next, struct alarm, node);
+
+		if (alarm->softexpires.tv64 > first->node.expires.tv64)
+			break;
+		if (alarm->softexpires.tv64 > soft.tv64)
+			soft = alarm->softexpires;
+	}
+	return soft;
+}
+
 static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 {
+	struct timerqueue_node *next;
 	struct alarm *alarm;
 	bool is_wakeup = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
 			base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
@@ -82,13 +117,14 @@ static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 	if (is_wakeup && !suspended && head_removed)
 		wake_unlock(&alarm_rtc_wake_lock);
 
-	if (!base->first)
+	next = timerqueue_getnext(&base->alarms);
+	if (!next)
 		return;
 
-	alarm = container_of(base->first, struct alarm, node);
+	alarm = container_of(next, struct alarm, node);
 
 	pr_alarm(FLOW, "selected alarm, type %d, func %pF at %lld\n",
-		alarm->type, alarm->function, ktime_to_ns(alarm->expires));
+		alarm->type, alarm->function, ktime_to_ns(alarm->node.expires));
 
 	if (is_wakeup && suspended) {
 		pr_alarm(FLOW, "changed alarm while suspened\n");
@@ -97,53 +133,28 @@ static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 	}
 
 	hrtimer_try_to_cancel(&base->timer);
-	base->timer.node.expires = ktime_add(base->delta, alarm->expires);
-	base->timer._softexpires = ktime_add(base->delta, alarm->softexpires);
+	base->timer.node.expires = ktime_add(base->delta, alarm->node.expires);
+	base->timer._softexpires = ktime_add(base->delta,
+					     alarm_batch_softexpires(alarm));
 	hrtimer_start_expires(&base->timer, HRTIMER_MODE_ABS);
 }
 
 static void alarm_enqueue_locked(struct alarm *alarm)
 {
 	struct alarm_queue *base = &alarms[alarm->type];
-	struct rb_node **link = &base->alarms.rb_node;
-	struct rb_node *parent = NULL;
-	struct alarm *entry;
-	int leftmost = 1;
 	bool was_first = false;
 
 	pr_alarm(FLOW, "added alarm, type %d, func %pF at %lld\n",
-		alarm->type, alarm->function, ktime_to_ns(alarm->expires));
+		alarm->type, alarm->function, ktime_to_ns(alarm->node.expires));
 
-	if (base->first == &alarm->node) {
-		base->first = rb_next(&alarm->node);
-		was_first = true;
-	}
-	if (!RB_EMPTY_NODE(&alarm->node)) {
-		rb_erase(&alarm->node, &base->alarms);
-		RB_CLEAR_NODE(&alarm->node);
+	if (!RB_EMPTY_NODE(&alarm->node.node)) {
+		was_first = timerqueue_getnext(&base->alarms) == &alarm->node;
+		timerqueue_del(&base->alarms, &alarm->node);
 	}
 
-	while (*link) {
-		parent = *link;
-		entry = rb_entry(parent, struct alarm, node);
-		/*
-		* We dont care about collisions. Nodes with
-		* the same expiry time stay together.
-		*/
-		if (alarm->expires.tv64 < entry->expires.tv64) {
-			link = &(*link)->rb_left;
-		} else {
-			link = &(*link)->rb_right;
-			leftmost = 0;
-		}
-	}
-	if (leftmost)
-		base->first = &alarm->node;
-	if (leftmost || was_first)
+	timerqueue_add(&base->alarms, &alarm->node);
+	if (was_first || timerqueue_getnext(&base->alarms) == &alarm->node)
 		update_timer_locked(base, was_first);
-
-	rb_link_node(&alarm->node, parent, link);
-	rb_insert_color(&alarm->node, &base->alarms);
 }
 
 /**
@@ -155,7 +166,7 @@ static void alarm_enqueue_locked(struct alarm *alarm)
 void alarm_init(struct alarm *alarm,
 	enum android_alarm_type type, void (*function)(struct alarm *))
 {
-	RB_CLEAR_NODE(&alarm->node);
+	timerqueue_init(&alarm->node);
 	alarm->type = type;
 	alarm->function = function;
 
@@ -175,7 +186,7 @@ void alarm_start_range(struct alarm *alarm, ktime_t start, ktime_t end)
 
 	spin_lock_irqsave(&alarm_slock, flags);
 	alarm->softexpires = start;
-	alarm->expires = end;
+	alarm->node.expires = end;
 	alarm_enqueue_locked(alarm);
 	spin_unlock_irqrestore(&alarm_slock, flags);
 }
@@ -198,17 +209,13 @@ int alarm_try_to_cancel(struct alarm *alarm)
 	int ret = 0;
 
 	spin_lock_irqsave(&alarm_slock, flags);
-	if (!RB_EMPTY_NODE(&alarm->node)) {
+	if (!RB_EMPTY_NODE(&alarm->node.node)) {
 		pr_alarm(FLOW, "canceled alarm, type %d, func %pF at %lld\n",
 			alarm->type, alarm->function,
-			ktime_to_ns(alarm->expires));
+			ktime_to_ns(alarm->node.expires));
 		ret = 1;
-		if (base->first == &alarm->node) {
-			base->first = rb_next(&alarm->node);
-			first = true;
-		}
-		rb_erase(&alarm->node, &base->alarms);
-		RB_CLEAR_NODE(&alarm->node);
+		first = timerqueue_getnext(&base->alarms) == &alarm->node;
+		timerqueue_del(&base->alarms, &alarm->node);
 		if (first)
 			update_timer_locked(base, true);
 	} else
@@ -320,39 +327,47 @@ ktime_t alarm_get_elapsed_realtime(void)
 static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
 {
 	struct alarm_queue *base;
+	struct timerqueue_node *next;
 	struct alarm *alarm;
 	unsigned long flags;
-	ktime_t now;
+	bool is_wakeup;
+	ktime_t now, counted;
 
 	spin_lock_irqsave(&alarm_slock, flags);
 
 	base = container_of(timer, struct alarm_queue, timer);
+	is_wakeup = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
+		    base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
 	now = base->stopped ? base->stopped_time : hrtimer_cb_get_time(timer);
 	now = ktime_sub(now, base->delta);
+	counted = now;
 
 	pr_alarm(INT, "alarm_timer_triggered type %d at %lld\n",
 		base - alarms, ktime_to_ns(now));
 
-	while (base->first) {
-		alarm = container_of(base->first, struct alarm, node);
+	while ((next = timerqueue_getnext(&base->alarms))) {
+		alarm = container_of(next, struct alarm, node);
 		if (alarm->softexpires.tv64 > now.tv64) {
 			pr_alarm(FLOW, "don't call alarm, %pF, %lld (s %lld)\n",
-				alarm->function, ktime_to_ns(alarm->expires),
+				alarm->function, ktime_to_ns(alarm->node.expires),
 				ktime_to_ns(alarm->softexpires));
 			break;
 		}
-		base->first = rb_next(&alarm->node);
-		rb_erase(&alarm->node, &base->alarms);
-		RB_CLEAR_NODE(&alarm->node);
+		timerqueue_del(&base->alarms, &alarm->node);
 		pr_alarm(CALL, "call alarm, type %d, func %pF, %lld (s %lld)\n",
 			alarm->type, alarm->function,
-			ktime_to_ns(alarm->expires),
+			ktime_to_ns(alarm->node.expires),
 			ktime_to_ns(alarm->softexpires));
+		/* alarms sharing an expiry would have shared a wakeup anyway */
+		if (is_wakeup && alarm->node.expires.tv64 > counted.tv64) {
+			batched_alarms++;
+			counted = alarm->node.expires;
+		}
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		alarm->function(alarm);
 		spin_lock_irqsave(&alarm_slock, flags);
 	}
-	if (!base->first)
+	if (!timerqueue_getnext(&base->alarms))
 		pr_alarm(FLOW, "no more alarms of type %d\n", base - alarms);
 	update_timer_locked(base, true);
 	spin_unlock_irqrestore(&alarm_slock, flags);
@@ -392,10 +407,10 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 			ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP].timer);
 
 	tmp_queue = &alarms[ANDROID_ALARM_RTC_WAKEUP];
-	if (tmp_queue->first)
+	if (timerqueue_getnext(&tmp_queue->alarms))
 		wakeup_queue = tmp_queue;
 	tmp_queue = &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
-	if (tmp_queue->first && (!wakeup_queue ||
+	if (timerqueue_getnext(&tmp_queue->alarms) && (!wakeup_queue ||
 				hrtimer_get_expires(&tmp_queue->timer).tv64 <
 				hrtimer_get_expires(&wakeup_queue->timer).tv64))
 		wakeup_queue = tmp_queue;
@@ -411,11 +426,21 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 			hrtimer_get_expires(&wakeup_queue->timer)),
 			rtc_delta).tv_sec;
 
-		rtc_time_to_tm(rtc_alarm_time, &rtc_alarm.time);
-		rtc_alarm.enabled = 1;
-		rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
-		rtc_read_time(alarm_rtc_dev, &rtc_current_rtc_time);
-		rtc_tm_to_time(&rtc_current_rtc_time, &rtc_current_time);
+		/*
+		 * The rtc alarm is left programmed over resumes which it
+		 * didn't cause, so don't write the same time again.
+		 */
+		if (rtc_alarm_time != rtc_alarm_programmed) {
+			rtc_time_to_tm(rtc_alarm_time, &rtc_alarm.time);
+			rtc_alarm.enabled = 1;
+			rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
+			rtc_alarm_programmed = rtc_alarm_time;
+			rtc_read_time(alarm_rtc_dev, &rtc_current_rtc_time);
+			rtc_tm_to_time(&rtc_current_rtc_time,
+				       &rtc_current_time);
+		} else {
+			rtc_writes_saved++;
+		}
 		pr_alarm(SUSPEND,
 			"rtc alarm set at %ld, now %ld, rtc delta %ld.%09ld\n",
 			rtc_alarm_time, rtc_current_time,
@@ -425,6 +450,7 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 			memset(&rtc_alarm, 0, sizeof(rtc_alarm));
 			rtc_alarm.enabled = 0;
 			rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
+			rtc_alarm_programmed = 0;
 
 			spin_lock_irqsave(&alarm_slock, flags);
 			suspended = false;
@@ -436,6 +462,11 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 			err = -EBUSY;
 			spin_unlock_irqrestore(&alarm_slock, flags);
 		}
+	} else if (rtc_alarm_programmed) {
+		memset(&rtc_alarm, 0, sizeof(rtc_alarm));
+		rtc_alarm.enabled = 0;
+		rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
+		rtc_alarm_programmed = 0;
 	}
 	return err;
 }
@@ -443,13 +474,27 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 static int alarm_resume(struct platform_device *pdev)
 {
 	struct rtc_wkalrm alarm;
+	struct rtc_time rtc_current_rtc_time;
+	unsigned long rtc_current_time;
 	unsigned long       flags;
 
 	pr_alarm(SUSPEND, "alarm_resume(%p)\n", pdev);
 
-	memset(&alarm, 0, sizeof(alarm));
-	alarm.enabled = 0;
-	rtc_set_alarm(alarm_rtc_dev, &alarm);
+	/*
+	 * Keep an rtc alarm which is still ahead: if the next suspend needs
+	 * the same wakeup, it doesn't have to be written again.  One going
+	 * off while awake only takes a short wake lock.
+	 */
+	if (rtc_alarm_programmed) {
+		rtc_read_time(alarm_rtc_dev, &rtc_current_rtc_time);
+		rtc_tm_to_time(&rtc_current_rtc_time, &rtc_current_time);
+		if (rtc_current_time + 1 >= rtc_alarm_programmed) {
+			memset(&alarm, 0, sizeof(alarm));
+			alarm.enabled = 0;
+			rtc_set_alarm(alarm_rtc_dev, &alarm);
+			rtc_alarm_programmed = 0;
+		}
+	}
 
 	spin_lock_irqsave(&alarm_slock, flags);
 	suspended = false;
@@ -551,6 +596,8 @@ static int __init alarm_driver_init(void)
 	int err;
 	int i;
 
+	for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++)
+		timerqueue_init_head(&alarms[i].alarms);
 	for (i = 0; i < ANDROID_ALARM_SYSTEMTIME; i++) {
 		hrtimer_init(&alarms[i].timer,
 				CLOCK_REALTIME, HRTIMER_MODE_ABS);
@@ -2134,7 +2134,7 @@ static void tegra_dc_one_shot_irq(struct tegra_dc *dc, unsigned long status)
 		tegra_dc_trigger_windows(dc);
 
 		/* Schedule any additional bottom-half vblank actvities. */
-		schedule_work(&dc->vblank_work);
+		queue_work(system_power_efficient_wq, &dc->vblank_work);
 	}
 
 	if (status & FRAME_END_INT) {
@@ -2150,7 +2150,7 @@ static void tegra_dc_continuous_irq(struct tegra_dc *dc, unsigned long status)
 {
 	if (status & V_BLANK_INT) {
 		/* Schedule any additional bottom-half vblank actvities. */
-		schedule_work(&dc->vblank_work);
+		queue_work(system_power_efficient_wq, &dc->vblank_work);
 	}
 
 	if (status & FRAME_END_INT) {
@@ -2197,8 +2197,8 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 	/* Check underflow */
 	if (underflow_mask) {
 		dc->underflow_mask |= underflow_mask;
-		schedule_delayed_work(&dc->underflow_work,
-			msecs_to_jiffies(1));
+		queue_delayed_work(system_power_efficient_wq,
+			&dc->underflow_work, msecs_to_jiffies(1));
 	}
 
 	if (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE)
@@ -2802,6 +2802,9 @@ static int tegra_dc_probe(struct nvhost_device *ndev)
 
 	nvhost_set_drvdata(ndev, dc);
 
+	/* bringing the panel back up doesn't hold up the other devices */
+	device_enable_async_resume(&ndev->dev);
+
 #ifdef CONFIG_SWITCH
 	dc->modeset_switch.name = dev_name(&ndev->dev);
 	dc->modeset_switch.state = 0;
@@ -169,13 +169,14 @@ static int to_state_powergated_locked(struct nvhost_device *dev)
 static void schedule_powergating_locked(struct nvhost_device *dev)
 {
 	if (dev->can_powergate)
-		schedule_delayed_work(&dev->powerstate_down,
+		queue_delayed_work(system_power_efficient_wq,
+				&dev->powerstate_down,
 				msecs_to_jiffies(dev->powergate_delay));
 }
 
 static void schedule_clockgating_locked(struct nvhost_device *dev)
 {
-	schedule_delayed_work(&dev->powerstate_down,
+	queue_delayed_work(system_power_efficient_wq, &dev->powerstate_down,
 			msecs_to_jiffies(dev->clockgate_delay));
 }
 
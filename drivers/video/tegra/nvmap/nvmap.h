@@ -178,6 +178,9 @@ struct nvmap_handle_ref *nvmap_create_handle(struct nvmap_client *client,
 struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 						   unsigned long id);
 
+struct nvmap_handle_ref *nvmap_duplicate_handle(struct nvmap_client *client,
+						struct nvmap_handle *h);
+
 
 int nvmap_alloc_handle_id(struct nvmap_client *client,
 			  unsigned long id, unsigned int heap_mask,
@@ -232,6 +235,9 @@ static inline pgprot_t nvmap_pgprot(struct nvmap_handle *h, pgprot_t prot)
 
 int is_nvmap_vma(struct vm_area_struct *vma);
 
+struct dentry;
+void nvmap_cache_maint_debugfs_init(struct dentry *root);
+
 struct nvmap_handle_ref *nvmap_alloc_iovm(struct nvmap_client *client,
 	size_t size, size_t align, unsigned int flags, unsigned int iova_start);
 
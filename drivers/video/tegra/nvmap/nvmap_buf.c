@@ -0,0 +1,313 @@
+/*
+ * drivers/video/tegra/nvmap/nvmap_buf.c
+ *
+ * Sharing nvmap handles with other drivers through file descriptors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* an nvmap handle is exported as an anonymous file which holds a reference
+ * to the handle. the file can be passed to other processes as an fd and
+ * imported into their nvmap client, or handed to another driver, which
+ * attaches its struct device and maps the backing pages for DMA. no data
+ * is ever copied: every importer sees the pages of the original handle.
+ */
+
+#include <linux/anon_inodes.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include <mach/nvmap.h>
+
+#include "nvmap.h"
+#include "nvmap_ioctl.h"
+
+struct nvmap_buf_attachment {
+	struct file *file;
+	struct nvmap_handle *handle;
+	struct device *dev;
+	bool mapped_pages;	/* sg entries were mapped with dma_map_sg */
+};
+
+static int nvmap_buf_release(struct inode *inode, struct file *file)
+{
+	struct nvmap_handle *h = file->private_data;
+
+	nvmap_handle_put(h);
+	return 0;
+}
+
+static const struct file_operations nvmap_buf_fops = {
+	.owner = THIS_MODULE,
+	.release = nvmap_buf_release,
+};
+
+static inline bool is_nvmap_buf(struct file *file)
+{
+	return file->f_op == &nvmap_buf_fops;
+}
+
+/* returns a new file which holds a reference to the handle id, which must
+ * already be referenced by client */
+struct file *nvmap_buf_export(struct nvmap_client *client, unsigned long id)
+{
+	struct nvmap_handle *h;
+	struct file *file;
+
+	h = nvmap_get_handle_id(client, id);
+	if (!h)
+		return ERR_PTR(-EPERM);
+
+	if (!h->alloc) {
+		nvmap_handle_put(h);
+		return ERR_PTR(-EINVAL);
+	}
+
+	file = anon_inode_getfile("nvmap-buf", &nvmap_buf_fops, h, O_RDWR);
+	if (IS_ERR(file))
+		nvmap_handle_put(h);
+
+	return file;
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_export);
+
+/* looks up fd, which must refer to an exported nvmap buffer. the returned
+ * file must be released with nvmap_buf_put */
+struct file *nvmap_buf_get(int fd)
+{
+	struct file *file = fget(fd);
+
+	if (!file)
+		return ERR_PTR(-EBADF);
+
+	if (!is_nvmap_buf(file)) {
+		fput(file);
+		return ERR_PTR(-EINVAL);
+	}
+	return file;
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_get);
+
+void nvmap_buf_put(struct file *file)
+{
+	fput(file);
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_put);
+
+size_t nvmap_buf_size(struct file *file)
+{
+	struct nvmap_handle *h = file->private_data;
+
+	return h->orig_size ? h->orig_size : h->size;
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_size);
+
+/* adds a reference to the exported handle to client */
+struct nvmap_handle_ref *nvmap_buf_import(struct nvmap_client *client,
+					  struct file *file)
+{
+	struct nvmap_handle *h;
+
+	if (!is_nvmap_buf(file))
+		return ERR_PTR(-EINVAL);
+
+	h = nvmap_handle_get(file->private_data);
+	if (!h)
+		return ERR_PTR(-EINVAL);
+
+	return nvmap_duplicate_handle(client, h);
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_import);
+
+struct nvmap_buf_attachment *nvmap_buf_attach(struct file *file,
+					      struct device *dev)
+{
+	struct nvmap_buf_attachment *a;
+
+	if (!is_nvmap_buf(file) || !dev)
+		return ERR_PTR(-EINVAL);
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a)
+		return ERR_PTR(-ENOMEM);
+
+	get_file(file);
+	a->file = file;
+	a->handle = file->private_data;
+	a->dev = dev;
+	return a;
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_attach);
+
+void nvmap_buf_detach(struct nvmap_buf_attachment *a)
+{
+	if (!a)
+		return;
+	fput(a->file);
+	kfree(a);
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_detach);
+
+/* returns a scatterlist describing the pages of the buffer, with the DMA
+ * addresses filled in for the attached device. carveouts are locked
+ * against relocation until the scatterlist is unmapped */
+struct sg_table *nvmap_buf_map(struct nvmap_buf_attachment *a,
+			       enum dma_data_direction dir)
+{
+	struct nvmap_handle *h = a->handle;
+	struct sg_table *sgt;
+	struct scatterlist *sg;
+	unsigned int i;
+	int err;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	if (h->heap_pgalloc) {
+		unsigned int nr = h->size >> PAGE_SHIFT;
+
+		err = sg_alloc_table(sgt, nr, GFP_KERNEL);
+		if (err)
+			goto fail;
+
+		for_each_sg(sgt->sgl, sg, nr, i)
+			sg_set_page(sg, h->pgalloc.pages[i], PAGE_SIZE, 0);
+
+		if (!dma_map_sg(a->dev, sgt->sgl, sgt->nents, dir)) {
+			sg_free_table(sgt);
+			err = -EIO;
+			goto fail;
+		}
+		a->mapped_pages = true;
+		return sgt;
+	}
+
+	err = sg_alloc_table(sgt, 1, GFP_KERNEL);
+	if (err)
+		goto fail;
+
+	/* lock carveout from relocation by mapcount */
+	nvmap_usecount_inc(h);
+
+	sg = sgt->sgl;
+	if (pfn_valid(__phys_to_pfn(h->carveout->base))) {
+		sg_set_page(sg, phys_to_page(h->carveout->base), h->size, 0);
+		if (!dma_map_sg(a->dev, sg, 1, dir)) {
+			nvmap_usecount_dec(h);
+			sg_free_table(sgt);
+			err = -EIO;
+			goto fail;
+		}
+		a->mapped_pages = true;
+	} else {
+		/* carveouts removed from the kernel's memory map have no
+		 * struct page; hand out the physical range directly. CPU
+		 * cache maintenance is done through the nvmap cache ops */
+		sg->length = h->size;
+		sg_dma_address(sg) = h->carveout->base;
+		sg_dma_len(sg) = h->size;
+		a->mapped_pages = false;
+	}
+	return sgt;
+
+fail:
+	kfree(sgt);
+	return ERR_PTR(err);
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_map);
+
+void nvmap_buf_unmap(struct nvmap_buf_attachment *a, struct sg_table *sgt,
+		     enum dma_data_direction dir)
+{
+	struct nvmap_handle *h = a->handle;
+
+	if (a->mapped_pages)
+		dma_unmap_sg(a->dev, sgt->sgl, sgt->nents, dir);
+	if (!h->heap_pgalloc)
+		nvmap_usecount_dec(h);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+EXPORT_SYMBOL_GPL(nvmap_buf_unmap);
+
+int nvmap_ioctl_share_fd(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_buf_fd op;
+	struct file *file;
+	int fd;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.handle)
+		return -EINVAL;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		return fd;
+
+	file = nvmap_buf_export(client, op.handle);
+	if (IS_ERR(file)) {
+		put_unused_fd(fd);
+		return PTR_ERR(file);
+	}
+
+	op.fd = fd;
+	if (copy_to_user(arg, &op, sizeof(op))) {
+		put_unused_fd(fd);
+		fput(file);
+		return -EFAULT;
+	}
+
+	fd_install(fd, file);
+	return 0;
+}
+
+int nvmap_ioctl_from_fd(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_handle_ref *ref;
+	struct nvmap_buf_fd op;
+	struct file *file;
+	int err = 0;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	file = nvmap_buf_get(op.fd);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	ref = nvmap_buf_import(client, file);
+	nvmap_buf_put(file);
+	if (IS_ERR(ref))
+		return PTR_ERR(ref);
+
+	op.handle = nvmap_ref_to_id(ref);
+	if (copy_to_user(arg, &op, sizeof(op))) {
+		err = -EFAULT;
+		nvmap_free_handle_id(client, op.handle);
+	}
+	return err;
+}
@@ -0,0 +1,225 @@
+/*
+ * drivers/video/tegra/nvmap/nvmap_buf_test.c
+ *
+ * Loopback test for nvmap shareable buffers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* a producer device allocates a buffer in its own nvmap client, fills it
+ * and exports it. a consumer device imports the buffer into a second
+ * client and attaches to it. the test passes when both devices map the
+ * same DMA addresses and the consumer reads the producer's data through
+ * its own reference, i.e. the buffer moved without being copied.
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+
+#include <asm/sizes.h>
+
+#include <mach/nvmap.h>
+
+#define TEST_SIZE	SZ_64K
+
+struct buf_test_dev {
+	struct platform_device *pdev;
+	struct nvmap_client *client;
+	struct nvmap_handle_ref *ref;
+	struct nvmap_buf_attachment *attach;
+	struct sg_table *sgt;
+	enum dma_data_direction dir;
+};
+
+static int __init buf_test_dev_init(struct buf_test_dev *t, int id,
+				    enum dma_data_direction dir)
+{
+	t->pdev = platform_device_register_simple("nvmap-buf-test", id,
+						  NULL, 0);
+	if (IS_ERR(t->pdev))
+		return PTR_ERR(t->pdev);
+
+	t->pdev->dev.coherent_dma_mask = DMA_BIT_MASK(32);
+	t->pdev->dev.dma_mask = &t->pdev->dev.coherent_dma_mask;
+	t->dir = dir;
+
+	t->client = nvmap_create_client(nvmap_dev, dev_name(&t->pdev->dev));
+	if (!t->client)
+		return -ENOMEM;
+	return 0;
+}
+
+static void buf_test_dev_exit(struct buf_test_dev *t)
+{
+	if (t->sgt)
+		nvmap_buf_unmap(t->attach, t->sgt, t->dir);
+	if (t->attach)
+		nvmap_buf_detach(t->attach);
+	if (t->ref && !IS_ERR(t->ref))
+		nvmap_free(t->client, t->ref);
+	if (t->client)
+		nvmap_client_put(t->client);
+	if (t->pdev && !IS_ERR(t->pdev))
+		platform_device_unregister(t->pdev);
+}
+
+static int __init buf_test_attach(struct buf_test_dev *t, struct file *file)
+{
+	t->attach = nvmap_buf_attach(file, &t->pdev->dev);
+	if (IS_ERR(t->attach)) {
+		int err = PTR_ERR(t->attach);
+		t->attach = NULL;
+		return err;
+	}
+
+	t->sgt = nvmap_buf_map(t->attach, t->dir);
+	if (IS_ERR(t->sgt)) {
+		int err = PTR_ERR(t->sgt);
+		t->sgt = NULL;
+		return err;
+	}
+	return 0;
+}
+
+/* both devices must see the same DMA address ranges, in order */
+static bool __init buf_test_same_pages(struct sg_table *a, struct sg_table *b)
+{
+	struct scatterlist *sa = a->sgl;
+	struct scatterlist *sb = b->sgl;
+	dma_addr_t addr_a = 0, addr_b = 0;
+	size_t left_a = 0, left_b = 0;
+
+	while (sa || sb) {
+		size_t n;
+
+		if (!left_a && sa) {
+			addr_a = sg_dma_address(sa);
+			left_a = sg_dma_len(sa);
+			sa = sg_next(sa);
+		}
+		if (!left_b && sb) {
+			addr_b = sg_dma_address(sb);
+			left_b = sg_dma_len(sb);
+			sb = sg_next(sb);
+		}
+		if (!left_a || !left_b || addr_a != addr_b)
+			return false;
+
+		n = min(left_a, left_b);
+		addr_a += n;
+		addr_b += n;
+		left_a -= n;
+		left_b -= n;
+	}
+	return !left_a && !left_b;
+}
+
+static int __init nvmap_buf_test(void)
+{
+	struct buf_test_dev producer = { 0 }, consumer = { 0 };
+	struct file *file = NULL;
+	u32 *p;
+	unsigned int i;
+	int err;
+
+	if (!nvmap_dev)
+		return 0;
+
+	err = buf_test_dev_init(&producer, 0, DMA_TO_DEVICE);
+	if (!err)
+		err = buf_test_dev_init(&consumer, 1, DMA_FROM_DEVICE);
+	if (err)
+		goto out;
+
+	producer.ref = nvmap_alloc(producer.client, TEST_SIZE, PAGE_SIZE,
+				   NVMAP_HANDLE_WRITE_COMBINE);
+	if (IS_ERR(producer.ref)) {
+		err = PTR_ERR(producer.ref);
+		goto out;
+	}
+
+	p = nvmap_mmap(producer.ref);
+	if (!p) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < TEST_SIZE / sizeof(*p); i++)
+		p[i] = i ^ 0x5a5a5a5a;
+	wmb();
+	nvmap_munmap(producer.ref, p);
+
+	file = nvmap_buf_export(producer.client,
+				(unsigned long)nvmap_ref_to_handle(producer.ref));
+	if (IS_ERR(file)) {
+		err = PTR_ERR(file);
+		file = NULL;
+		goto out;
+	}
+
+	err = buf_test_attach(&producer, file);
+	if (err)
+		goto out;
+
+	consumer.ref = nvmap_buf_import(consumer.client, file);
+	if (IS_ERR(consumer.ref)) {
+		err = PTR_ERR(consumer.ref);
+		goto out;
+	}
+
+	/* the consumer reaches the buffer only through the exported file */
+	err = buf_test_attach(&consumer, file);
+	if (err)
+		goto out;
+
+	if (!buf_test_same_pages(producer.sgt, consumer.sgt)) {
+		pr_err("nvmap_buf_test: producer and consumer map "
+		       "different pages\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	p = nvmap_mmap(consumer.ref);
+	if (!p) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < TEST_SIZE / sizeof(*p); i++) {
+		if (p[i] != (i ^ 0x5a5a5a5a)) {
+			pr_err("nvmap_buf_test: mismatch at word %u\n", i);
+			err = -EINVAL;
+			break;
+		}
+	}
+	nvmap_munmap(consumer.ref, p);
+
+out:
+	buf_test_dev_exit(&consumer);
+	buf_test_dev_exit(&producer);
+	if (file)
+		nvmap_buf_put(file);
+
+	if (err)
+		pr_err("nvmap_buf_test: FAILED (%d)\n", err);
+	else
+		pr_info("nvmap_buf_test: passed, %u bytes shared without copy\n",
+			TEST_SIZE);
+	return err;
+}
+late_initcall(nvmap_buf_test);
@@ -865,6 +865,18 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_cache_maint(filp, uarg);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST:
+		err = nvmap_ioctl_cache_maint_list(filp, uarg);
+		break;
+
+	case NVMAP_IOC_SHARE_FD:
+		err = nvmap_ioctl_share_fd(filp, uarg);
+		break;
+
+	case NVMAP_IOC_FROM_FD:
+		err = nvmap_ioctl_from_fd(filp, uarg);
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -1271,7 +1283,7 @@ static int nvmap_probe(struct platform_device *pdev)
 			continue;
 		node->carveout = nvmap_heap_create(dev->dev_user.this_device,
 				   co->name, co->base, co->size,
-				   co->buddy_size, node);
+				   co->buddy_size, co->movable, node);
 		if (!node->carveout) {
 			e = -ENOMEM;
 			dev_err(&pdev->dev, "couldn't create %s\n", co->name);
@@ -1309,6 +1321,7 @@ static int nvmap_probe(struct platform_device *pdev)
 			debugfs_create_file("allocations", 0664, iovmm_root,
 				dev, &debug_iovmm_allocations_fops);
 		}
+		nvmap_cache_maint_debugfs_init(nvmap_debug_root);
 	}
 
 	platform_set_drvdata(pdev, dev);
@@ -537,7 +537,6 @@ struct nvmap_handle_ref *nvmap_create_handle(struct nvmap_client *client,
 struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 						   unsigned long id)
 {
-	struct nvmap_handle_ref *ref = NULL;
 	struct nvmap_handle *h = NULL;
 
 	BUG_ON(!client || client->dev != nvmap_dev);
@@ -551,6 +550,17 @@ struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 		return ERR_PTR(-EPERM);
 	}
 
+	return nvmap_duplicate_handle(client, h);
+}
+
+/* adds a reference to h to client. the caller's reference count on h is
+ * consumed by the new handle_ref on success, and dropped on failure */
+struct nvmap_handle_ref *nvmap_duplicate_handle(struct nvmap_client *client,
+						struct nvmap_handle *h)
+{
+	struct nvmap_handle_ref *ref = NULL;
+	unsigned long id = (unsigned long)h;
+
 	if (!h->alloc) {
 		nvmap_err(client, "%s duplicating unallocated handle\n",
 			  current->group_leader->comm);
@@ -27,6 +27,12 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/rbtree.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
+#include <linux/math64.h>
 
 #include <mach/nvmap.h>
 #include "nvmap.h"
@@ -50,9 +56,13 @@
  * to employ should be provided by the platform for each heap. it is possible
  * for a platform to define a heap where only the "normal" strategy is used.
  *
- * o "normal" allocations use an address-order first-fit allocator (called
- *   BOTTOM_UP in the code below). each allocation is rounded up to be
- *   an integer multiple of the "small" allocation size.
+ * o "normal" allocations use a best-fit allocator (called BOTTOM_UP in the
+ *   code below). free blocks are kept in an rbtree ordered by size, then
+ *   address, so the smallest fitting block is found in O(log n); among
+ *   blocks of equal size the lowest address wins. each allocation is
+ *   rounded up to be an integer multiple of the "small" allocation size.
+ *   relocations done by the compactor still use an address-order first
+ *   fit below the block being moved.
  *
  * o "huge" allocations use an address-order last-fit allocator (called
  *   TOP_DOWN in the code below). like "normal" allocations, each allocation
@@ -68,10 +78,35 @@
  * and to ensure that the minimum free block size in the carveout (i.e., the
  * "small" threshold) is still a meaningful size.
  *
+ * with the carveout compactor, a deferrable work item also compacts the
+ * heap in the background once it has been idle for compact_idle_ms and
+ * its fragmentation is above compact_frag_threshold. each run relocates at
+ * most compact_batch unpinned blocks into lower free space, so the heap
+ * lock is never held for long.
+ *
+ * a "movable" heap is lent to the page allocator as MIGRATE_CMA memory
+ * while it is free. every list block handed out by the heap is first
+ * claimed back with alloc_contig_range(), which migrates away whatever
+ * movable pages the page allocator placed there, and is given back to
+ * the page allocator when it is freed. list blocks of a movable heap are
+ * always page aligned, so a page is claimed iff it belongs to a block.
+ *
  */
 
 #define MAX_BUDDY_NR	128	/* maximum buddies in a buddy allocator */
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+static unsigned int compact_idle_ms = 2000;
+module_param(compact_idle_ms, uint, 0644);
+
+/* fragmentation, in 1/1000, above which the background compactor runs */
+static unsigned int compact_frag_threshold = 200;
+module_param(compact_frag_threshold, uint, 0644);
+
+static unsigned int compact_batch = 4;
+module_param(compact_batch, uint, 0644);
+#endif
+
 enum direction {
 	TOP_DOWN,
 	BOTTOM_UP
@@ -94,8 +129,20 @@ struct heap_stat {
 	unsigned int compaction_count_fast;
 	/* full compaction attempt counter */
 	unsigned int compaction_count_full;
+	/* background compaction runs and relocated blocks */
+	unsigned int bg_compaction_runs;
+	unsigned int bg_compaction_moves;
 };
 
+/* fraction of free space, in 1/1000, not usable by the largest allocation
+ * that could succeed; 0 means all free space is one block. */
+static unsigned int frag_index(size_t free, size_t free_largest)
+{
+	if (!free)
+		return 0;
+	return 1000 - div_u64((u64)free_largest * 1000, free);
+}
+
 struct buddy_heap;
 
 struct buddy_block {
@@ -112,6 +159,7 @@ struct list_block {
 	size_t align;
 	struct nvmap_heap *heap;
 	struct list_head free_list;
+	struct rb_node free_node;	/* in heap->free_tree while free */
 };
 
 struct combo_block {
@@ -133,9 +181,28 @@ struct buddy_heap {
 	struct buddy_bits bitmap[MAX_BUDDY_NR];
 };
 
+/* cost of taking movable heap pages back from the page allocator */
+struct heap_claim_stat {
+	unsigned long count;		/* successful claims */
+	unsigned long failed;		/* claims that could not free the range */
+	unsigned long pages;		/* pages currently claimed */
+	unsigned long migrated;		/* pages migrated out by all claims */
+	u64 time_total_us;		/* time spent in successful claims */
+	u64 time_max_us;		/* slowest successful claim */
+};
+
+/* carveout compactor activity */
+struct heap_compact_stat {
+	unsigned int fast;		/* fast compactions on allocation failure */
+	unsigned int full;		/* full compactions on allocation failure */
+	unsigned int bg_runs;		/* background compaction runs */
+	unsigned int bg_moves;		/* blocks relocated in the background */
+};
+
 struct nvmap_heap {
 	struct list_head all_list;
 	struct list_head free_list;
+	struct rb_root free_tree;	/* free blocks by size, then address */
 	struct mutex lock;
 	struct list_head buddy_list;
 	unsigned int min_buddy_shift;
@@ -144,6 +211,13 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+	bool movable;
+	struct heap_claim_stat claim;
+	struct heap_compact_stat compact;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+	unsigned long last_activity;	/* jiffies of the last alloc or free */
+#endif
 };
 
 static struct kmem_cache *buddy_heap_cache;
@@ -215,6 +289,10 @@ static unsigned long heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 		stat->free_count++;
 		stat->free_largest = max(l->size, stat->free_largest);
 	}
+	stat->compaction_count_fast = heap->compact.fast;
+	stat->compaction_count_full = heap->compact.full;
+	stat->bg_compaction_runs = heap->compact.bg_runs;
+	stat->bg_compaction_moves = heap->compact.bg_moves;
 	mutex_unlock(&heap->lock);
 
 	return base;
@@ -247,6 +325,21 @@ static struct device_attribute heap_stat_free_size =
 static struct device_attribute heap_stat_base =
 	__ATTR(base, S_IRUGO, heap_stat_show, NULL);
 
+static struct device_attribute heap_stat_fragmentation =
+	__ATTR(fragmentation, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_fast =
+	__ATTR(compact_fast, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_full =
+	__ATTR(compact_full, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_bg_runs =
+	__ATTR(compact_bg_runs, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_bg_moves =
+	__ATTR(compact_bg_moves, S_IRUGO, heap_stat_show, NULL);
+
 static struct device_attribute heap_attr_name =
 	__ATTR(name, S_IRUGO, heap_name_show, NULL);
 
@@ -258,6 +351,11 @@ static struct attribute *heap_stat_attrs[] = {
 	&heap_stat_free_count.attr,
 	&heap_stat_free_size.attr,
 	&heap_stat_base.attr,
+	&heap_stat_fragmentation.attr,
+	&heap_stat_compact_fast.attr,
+	&heap_stat_compact_full.attr,
+	&heap_stat_compact_bg_runs.attr,
+	&heap_stat_compact_bg_moves.attr,
 	&heap_attr_name.attr,
 	NULL,
 };
@@ -266,6 +364,41 @@ static struct attribute_group heap_stat_attr_group = {
 	.attrs	= heap_stat_attrs,
 };
 
+static ssize_t heap_claim_show(struct device *dev,
+			       struct device_attribute *attr, char *buf);
+
+static struct device_attribute heap_claim_count =
+	__ATTR(claim_count, S_IRUGO, heap_claim_show, NULL);
+
+static struct device_attribute heap_claim_failed =
+	__ATTR(claim_failed, S_IRUGO, heap_claim_show, NULL);
+
+static struct device_attribute heap_claim_pages =
+	__ATTR(claim_pages, S_IRUGO, heap_claim_show, NULL);
+
+static struct device_attribute heap_claim_migrated =
+	__ATTR(claim_migrated, S_IRUGO, heap_claim_show, NULL);
+
+static struct device_attribute heap_claim_time_total =
+	__ATTR(claim_time_total_us, S_IRUGO, heap_claim_show, NULL);
+
+static struct device_attribute heap_claim_time_max =
+	__ATTR(claim_time_max_us, S_IRUGO, heap_claim_show, NULL);
+
+static struct attribute *heap_claim_attrs[] = {
+	&heap_claim_count.attr,
+	&heap_claim_failed.attr,
+	&heap_claim_pages.attr,
+	&heap_claim_migrated.attr,
+	&heap_claim_time_total.attr,
+	&heap_claim_time_max.attr,
+	NULL,
+};
+
+static struct attribute_group heap_claim_attr_group = {
+	.attrs	= heap_claim_attrs,
+};
+
 static ssize_t heap_name_show(struct device *dev,
 			      struct device_attribute *attr, char *buf)
 {
@@ -297,9 +430,122 @@ static ssize_t heap_stat_show(struct device *dev,
 		return sprintf(buf, "%u\n", stat.free);
 	else if (attr == &heap_stat_base)
 		return sprintf(buf, "%08lx\n", base);
+	else if (attr == &heap_stat_fragmentation)
+		return sprintf(buf, "%u\n",
+			       frag_index(stat.free, stat.free_largest));
+	else if (attr == &heap_stat_compact_fast)
+		return sprintf(buf, "%u\n", stat.compaction_count_fast);
+	else if (attr == &heap_stat_compact_full)
+		return sprintf(buf, "%u\n", stat.compaction_count_full);
+	else if (attr == &heap_stat_compact_bg_runs)
+		return sprintf(buf, "%u\n", stat.bg_compaction_runs);
+	else if (attr == &heap_stat_compact_bg_moves)
+		return sprintf(buf, "%u\n", stat.bg_compaction_moves);
 	else
 		return -EINVAL;
 }
+
+static ssize_t heap_claim_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct nvmap_heap *heap = container_of(dev, struct nvmap_heap, dev);
+	struct heap_claim_stat stat;
+
+	mutex_lock(&heap->lock);
+	stat = heap->claim;
+	mutex_unlock(&heap->lock);
+
+	if (attr == &heap_claim_count)
+		return sprintf(buf, "%lu\n", stat.count);
+	else if (attr == &heap_claim_failed)
+		return sprintf(buf, "%lu\n", stat.failed);
+	else if (attr == &heap_claim_pages)
+		return sprintf(buf, "%lu\n", stat.pages);
+	else if (attr == &heap_claim_migrated)
+		return sprintf(buf, "%lu\n", stat.migrated);
+	else if (attr == &heap_claim_time_total)
+		return sprintf(buf, "%llu\n", stat.time_total_us);
+	else if (attr == &heap_claim_time_max)
+		return sprintf(buf, "%llu\n", stat.time_max_us);
+	else
+		return -EINVAL;
+}
+
+/* a list block covers [orig_addr, block.base + size) of the heap */
+static inline phys_addr_t list_block_start(struct list_block *b)
+{
+	return b->orig_addr;
+}
+
+static inline size_t list_block_extent(struct list_block *b)
+{
+	return b->block.base + b->size - b->orig_addr;
+}
+
+#ifdef CONFIG_NVMAP_CARVEOUT_MOVABLE
+/* takes the pages backing [base, base + len) back from the page allocator;
+ * must be called while holding the heap's lock. */
+static int heap_claim_range(struct nvmap_heap *heap, phys_addr_t base,
+			    size_t len)
+{
+	struct nvmap_heap_block tmp = { .base = base };
+	unsigned long pfn = __phys_to_pfn(base);
+	unsigned long nr = PAGE_ALIGN(len) >> PAGE_SHIFT;
+	unsigned long migrated = 0;
+	ktime_t start;
+	u64 us;
+	int err;
+
+	if (!heap->movable)
+		return 0;
+
+	start = ktime_get();
+	err = alloc_contig_range(pfn, pfn + nr, &migrated);
+	if (err) {
+		heap->claim.failed++;
+		dev_dbg(&heap->dev, "unable to claim %08lx..%08lx: %d\n",
+			(unsigned long)base, (unsigned long)(base + len), err);
+		return err;
+	}
+
+	/* the page allocator may have left dirty lines for these pages */
+	nvmap_flush_heap_block(NULL, &tmp, nr << PAGE_SHIFT,
+			       NVMAP_HANDLE_CACHEABLE);
+
+	us = ktime_us_delta(ktime_get(), start);
+	heap->claim.count++;
+	heap->claim.pages += nr;
+	heap->claim.migrated += migrated;
+	heap->claim.time_total_us += us;
+	heap->claim.time_max_us = max(heap->claim.time_max_us, us);
+	return 0;
+}
+
+/* gives the pages backing [base, base + len) back to the page allocator;
+ * must be called while holding the heap's lock. */
+static void heap_release_range(struct nvmap_heap *heap, phys_addr_t base,
+			       size_t len)
+{
+	unsigned long nr = PAGE_ALIGN(len) >> PAGE_SHIFT;
+
+	if (!heap->movable)
+		return;
+
+	free_contig_range(__phys_to_pfn(base), nr);
+	heap->claim.pages -= nr;
+}
+#else
+static inline int heap_claim_range(struct nvmap_heap *heap, phys_addr_t base,
+				   size_t len)
+{
+	return 0;
+}
+
+static inline void heap_release_range(struct nvmap_heap *heap,
+				      phys_addr_t base, size_t len)
+{
+}
+#endif
 #ifndef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 static struct nvmap_heap_block *buddy_alloc(struct buddy_heap *heap,
 					    size_t size, size_t align,
@@ -384,6 +630,68 @@ static struct buddy_heap *do_buddy_free(struct nvmap_heap_block *block)
 }
 
 
+static void free_tree_insert(struct nvmap_heap *heap, struct list_block *b)
+{
+	struct rb_node **p = &heap->free_tree.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		struct list_block *i;
+
+		parent = *p;
+		i = rb_entry(parent, struct list_block, free_node);
+		if (b->size < i->size ||
+		    (b->size == i->size && b->block.base < i->block.base))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	rb_link_node(&b->free_node, parent, p);
+	rb_insert_color(&b->free_node, &heap->free_tree);
+}
+
+static inline void free_tree_erase(struct nvmap_heap *heap,
+				   struct list_block *b)
+{
+	rb_erase(&b->free_node, &heap->free_tree);
+}
+
+/* returns the smallest free block which can hold len bytes aligned to
+ * align, and the aligned base of the allocation in *fix_base. */
+static struct list_block *free_tree_best_fit(struct nvmap_heap *heap,
+					     size_t len, size_t align,
+					     unsigned long *fix_base)
+{
+	struct rb_node *n = heap->free_tree.rb_node;
+	struct list_block *first = NULL;
+
+	/* leftmost block at least len bytes long */
+	while (n) {
+		struct list_block *i = rb_entry(n, struct list_block, free_node);
+
+		if (i->size >= len) {
+			first = i;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+
+	/* alignment may waste the head of a block; try larger ones */
+	for (n = first ? &first->free_node : NULL; n; n = rb_next(n)) {
+		struct list_block *i = rb_entry(n, struct list_block, free_node);
+		unsigned long base = ALIGN(i->block.base, align);
+
+		if (base - i->block.base + len <= i->size) {
+			*fix_base = base;
+			return i;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * base_max limits position of allocated chunk in memory.
  * if base_max is 0 then there is no such limitation.
@@ -416,7 +724,9 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 	dir = (len <= heap->small_alloc) ? BOTTOM_UP : TOP_DOWN;
 #endif
 
-	if (dir == BOTTOM_UP) {
+	if (dir == BOTTOM_UP && !base_max) {
+		b = free_tree_best_fit(heap, len, align, &fix_base);
+	} else if (dir == BOTTOM_UP) {
 		list_for_each_entry(i, &heap->free_list, free_list) {
 			size_t fix_size;
 			fix_base = ALIGN(i->block.base, align);
@@ -448,6 +758,8 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 	if (!b)
 		return NULL;
 
+	free_tree_erase(heap, b);
+
 	if (dir == BOTTOM_UP)
 		b->block.type = BLOCK_FIRST_FIT;
 
@@ -471,6 +783,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		b->size -= rem->size;
 		list_add_tail(&rem->all_list,  &b->all_list);
 		list_add_tail(&rem->free_list, &b->free_list);
+		free_tree_insert(heap, rem);
 	}
 
 	b->orig_addr = b->block.base;
@@ -489,6 +802,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		b->size = len;
 		list_add(&rem->all_list,  &b->all_list);
 		list_add(&rem->free_list, &b->free_list);
+		free_tree_insert(heap, rem);
 	}
 
 out:
@@ -550,6 +864,7 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 		if (n->block.base == b->block.base + b->size) {
 			list_del(&n->all_list);
 			list_del(&n->free_list);
+			free_tree_erase(heap, n);
 			BUG_ON(b->orig_addr >= n->orig_addr);
 			b->size += n->size;
 			kmem_cache_free(block_cache, n);
@@ -561,6 +876,7 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 	if (b->free_list.prev != &heap->free_list) {
 		n = list_entry(b->free_list.prev, struct list_block, free_list);
 		if (n->block.base + n->size == b->block.base) {
+			free_tree_erase(heap, n);
 			list_del(&b->all_list);
 			list_del(&b->free_list);
 			BUG_ON(n->orig_addr >= b->orig_addr);
@@ -572,6 +888,36 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 
 	freelist_debug(heap, "free list after", b);
 	b->block.type = BLOCK_EMPTY;
+	free_tree_insert(heap, b);
+	return b;
+}
+
+/* allocates a list block and, for movable heaps, claims its pages back
+ * from the page allocator. */
+static struct nvmap_heap_block *do_heap_alloc_claimed(struct nvmap_heap *heap,
+						      size_t len, size_t align,
+						      unsigned int mem_prot,
+						      unsigned long base_max)
+{
+	struct nvmap_heap_block *b;
+	struct list_block *lb;
+
+	if (heap->movable) {
+		align = max_t(size_t, align, PAGE_SIZE);
+		len = PAGE_ALIGN(len);
+	}
+
+	b = do_heap_alloc(heap, len, align, mem_prot, base_max);
+	if (!b)
+		return NULL;
+
+	lb = container_of(b, struct list_block, block);
+	if (heap_claim_range(heap, list_block_start(lb),
+			     list_block_extent(lb))) {
+		do_heap_free(b);
+		return NULL;
+	}
+
 	return b;
 }
 
@@ -596,7 +942,7 @@ static struct nvmap_heap_block *do_buddy_alloc(struct nvmap_heap *h,
 	if (!bh)
 		return NULL;
 
-	b = do_heap_alloc(h, h->buddy_heap_size,
+	b = do_heap_alloc_claimed(h, h->buddy_heap_size,
 			h->buddy_heap_size, mem_prot, 0);
 	if (!b) {
 		kmem_cache_free(buddy_heap_cache, bh);
@@ -695,9 +1041,16 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 	size_t src_size = block->size;
 	size_t src_align = block->align;
 	unsigned int src_prot = block->mem_prot;
+	phys_addr_t src_start = list_block_start(block);
+	size_t src_extent = list_block_extent(block);
 	int error = 0;
 	struct nvmap_share *share;
 
+	/* the full path reuses the source range before the copy, which a
+	 * movable heap cannot claim ahead of time */
+	if (heap->movable)
+		fast = true;
+
 	if (!handle) {
 		pr_err("INVALID HANDLE!\n");
 		return NULL;
@@ -722,8 +1075,8 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 
 	if (fast) {
 		/* Fast compaction path - first allocate, then free. */
-		heap_block_new = do_heap_alloc(heap, src_size, src_align,
-				src_prot, src_base);
+		heap_block_new = do_heap_alloc_claimed(heap, src_size,
+				src_align, src_prot, src_base);
 		if (heap_block_new)
 			do_heap_free(heap_block);
 		else
@@ -752,6 +1105,10 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 				dst_base, src_base, src_size);
 	BUG_ON(error);
 
+	/* the source pages can go back to the page allocator now */
+	if (fast)
+		heap_release_range(heap, src_start, src_extent);
+
 fail:
 	mutex_unlock(&share->pin_lock);
 	mutex_unlock(&handle->lock);
@@ -822,6 +1179,100 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 	}
 	pr_err("Relocated %d chunks\n", relocation_count);
 }
+
+/* relocates at most max_moves unpinned blocks which sit above a free
+ * block into lower free space; must be called while holding the heap's
+ * lock. returns the number of relocated blocks. */
+static int nvmap_heap_compact_step(struct nvmap_heap *heap, int max_moves)
+{
+	struct list_block *b;
+	int moved = 0;
+
+	while (moved < max_moves) {
+		bool hole = false;
+		bool progress = false;
+
+		/* relocation frees and merges blocks, so restart the walk
+		 * after every successful move */
+		list_for_each_entry(b, &heap->all_list, all_list) {
+			if (b->block.type == BLOCK_EMPTY) {
+				hole = true;
+				continue;
+			}
+
+			if (!hole || b->block.type != BLOCK_FIRST_FIT)
+				continue;
+
+			if (do_heap_relocate_listblock(b, true)) {
+				progress = true;
+				break;
+			}
+		}
+
+		if (!progress)
+			break;
+		moved++;
+	}
+
+	return moved;
+}
+
+static unsigned int heap_frag_locked(struct nvmap_heap *heap)
+{
+	struct list_block *l;
+	size_t free = 0, free_largest = 0;
+
+	list_for_each_entry(l, &heap->free_list, free_list) {
+		free += l->size;
+		free_largest = max(free_largest, l->size);
+	}
+
+	return frag_index(free, free_largest);
+}
+
+static void heap_compact_work(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					       struct nvmap_heap, compact_work);
+	unsigned long idle_at;
+	int moved;
+
+	mutex_lock(&heap->lock);
+
+	/* wait until the heap has been idle for a while */
+	idle_at = heap->last_activity + msecs_to_jiffies(compact_idle_ms);
+	if (time_before(jiffies, idle_at)) {
+		mutex_unlock(&heap->lock);
+		schedule_delayed_work(&heap->compact_work, idle_at - jiffies);
+		return;
+	}
+
+	if (heap_frag_locked(heap) < compact_frag_threshold) {
+		mutex_unlock(&heap->lock);
+		return;
+	}
+
+	moved = nvmap_heap_compact_step(heap, compact_batch);
+	heap->compact.bg_runs++;
+	heap->compact.bg_moves += moved;
+	mutex_unlock(&heap->lock);
+
+	/* keep going in small steps while blocks can still be moved */
+	if (moved)
+		schedule_delayed_work(&heap->compact_work,
+				      msecs_to_jiffies(compact_idle_ms));
+}
+
+static void heap_note_activity(struct nvmap_heap *heap)
+{
+	heap->last_activity = jiffies;
+	schedule_delayed_work(&heap->compact_work,
+			      msecs_to_jiffies(compact_idle_ms));
+}
+#else
+static inline void heap_note_activity(struct nvmap_heap *heap)
+{
+}
 #endif
 
 void nvmap_usecount_inc(struct nvmap_handle *h)
@@ -857,15 +1308,17 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	/* Align to page size */
 	align = ALIGN(align, PAGE_SIZE);
 	len = ALIGN(len, PAGE_SIZE);
-	b = do_heap_alloc(h, len, align, prot, 0);
+	b = do_heap_alloc_claimed(h, len, align, prot, 0);
 	if (!b) {
 		pr_err("Compaction triggered!\n");
+		h->compact.fast++;
 		nvmap_heap_compact(h, len, true);
-		b = do_heap_alloc(h, len, align, prot, 0);
-		if (!b) {
+		b = do_heap_alloc_claimed(h, len, align, prot, 0);
+		if (!b && !h->movable) {
 			pr_err("Full compaction triggered!\n");
+			h->compact.full++;
 			nvmap_heap_compact(h, len, false);
-			b = do_heap_alloc(h, len, align, prot, 0);
+			b = do_heap_alloc_claimed(h, len, align, prot, 0);
 		}
 	}
 #else
@@ -875,13 +1328,14 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 		if (h->buddy_heap_size)
 			len = ALIGN(len, h->buddy_heap_size);
 		align = max(align, (size_t)L1_CACHE_BYTES);
-		b = do_heap_alloc(h, len, align, prot, 0);
+		b = do_heap_alloc_claimed(h, len, align, prot, 0);
 	}
 #endif
 
 	if (b) {
 		b->handle = handle;
 		handle->carveout = b;
+		heap_note_activity(h);
 	}
 	mutex_unlock(&h->lock);
 	return b;
@@ -906,14 +1360,20 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 	struct buddy_heap *bh = NULL;
 	struct nvmap_heap *h = nvmap_block_to_heap(b);
 	struct list_block *lb;
+	phys_addr_t start;
+	size_t extent;
 
 	mutex_lock(&h->lock);
 	if (b->type == BLOCK_BUDDY)
 		bh = do_buddy_free(b);
 	else {
 		lb = container_of(b, struct list_block, block);
+		start = list_block_start(lb);
+		extent = list_block_extent(lb);
 		nvmap_flush_heap_block(NULL, b, lb->size, lb->mem_prot);
 		do_heap_free(b);
+		heap_release_range(h, start, extent);
+		heap_note_activity(h);
 	}
 
 	if (bh) {
@@ -937,10 +1397,13 @@ static void heap_release(struct device *heap)
  * of the buddy heap size will use a buddy sub-allocator, where each buddy
  * heap is buddy_size bytes (should be a power of 2). all other allocations
  * will be rounded up to be a multiple of buddy_size bytes.
+ *
+ * if movable is set, the memory is owned by the page allocator until it is
+ * allocated from the heap (see the comment at the top of this file).
  */
 struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 				     phys_addr_t base, size_t len,
-				     size_t buddy_size, void *arg)
+				     size_t buddy_size, bool movable, void *arg)
 {
 	struct nvmap_heap *h = NULL;
 	struct list_block *l = NULL;
@@ -1000,6 +1463,15 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 		dev_err(&h->dev, "%s: failed to create attributes\n", __func__);
 		goto fail_register;
 	}
+#ifdef CONFIG_NVMAP_CARVEOUT_MOVABLE
+	h->movable = movable;
+	if (movable && sysfs_create_group(&h->dev.kobj,
+					  &heap_claim_attr_group))
+		dev_warn(&h->dev, "%s: failed to create claim attributes\n",
+			 __func__);
+#else
+	WARN_ON(movable);
+#endif
 	h->small_alloc = max(2 * buddy_size, len / 256);
 	h->buddy_heap_size = buddy_size;
 	if (buddy_size)
@@ -1007,13 +1479,18 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	INIT_LIST_HEAD(&h->free_list);
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
+	h->free_tree = RB_ROOT;
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK_DEFERRABLE(&h->compact_work, heap_compact_work);
+#endif
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
 	l->orig_addr = base;
 	list_add_tail(&l->free_list, &h->free_list);
 	list_add_tail(&l->all_list, &h->all_list);
+	free_tree_insert(h, l);
 
 	inner_flush_cache_all();
 	outer_flush_range(base, base + len);
@@ -1045,6 +1522,12 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 {
 	WARN_ON(!list_empty(&heap->buddy_list));
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
+
+	if (heap->movable)
+		sysfs_remove_group(&heap->dev.kobj, &heap_claim_attr_group);
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
@@ -20,10 +20,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
 
 #include <asm/cacheflush.h>
@@ -46,6 +53,96 @@ static ssize_t rw_handle(struct nvmap_client *client, struct nvmap_handle *h,
 static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 		       unsigned long start, unsigned long end, unsigned int op);
 
+static void outer_handle_cache_maint(struct nvmap_client *client,
+	struct nvmap_handle *h, unsigned long start, unsigned long end,
+	unsigned int op);
+
+/* a batched request whose write-back regions add up to at least this many
+ * bytes cleans/flushes the whole inner cache by set/way instead of walking
+ * each region by virtual address */
+static unsigned int cache_maint_whole_threshold =
+	FLUSH_CLEAN_BY_SET_WAY_THRESHOLD;
+module_param(cache_maint_whole_threshold, uint, 0644);
+
+#define NVMAP_CACHE_LIST_MAX	256
+
+struct cache_maint_stat {
+	unsigned long count;
+	u64 bytes;
+	u64 time_ns;
+	u64 max_ns;
+};
+
+static const char *const cache_maint_stat_name[] = {
+	[NVMAP_CACHE_OP_WB]	= "wb",
+	[NVMAP_CACHE_OP_INV]	= "inv",
+	[NVMAP_CACHE_OP_WB_INV]	= "wb_inv",
+	[NVMAP_CACHE_OP_WB_INV + 1] = "whole",
+};
+
+static DEFINE_SPINLOCK(cache_maint_stat_lock);
+/* one entry per NVMAP_CACHE_OP_*, plus one for set/way whole-cache ops */
+static struct cache_maint_stat cache_maint_stats[NVMAP_CACHE_OP_WB_INV + 2];
+static unsigned long cache_maint_batches;
+static unsigned long cache_maint_merged;
+
+static void cache_maint_account(unsigned int idx, u64 bytes, ktime_t start)
+{
+	struct cache_maint_stat *st = &cache_maint_stats[idx];
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&cache_maint_stat_lock);
+	st->count++;
+	st->bytes += bytes;
+	st->time_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	spin_unlock(&cache_maint_stat_lock);
+}
+
+static int cache_maint_stats_show(struct seq_file *s, void *unused)
+{
+	struct cache_maint_stat stats[ARRAY_SIZE(cache_maint_stats)];
+	unsigned long batches, merged;
+	unsigned int i;
+
+	spin_lock(&cache_maint_stat_lock);
+	memcpy(stats, cache_maint_stats, sizeof(stats));
+	batches = cache_maint_batches;
+	merged = cache_maint_merged;
+	spin_unlock(&cache_maint_stat_lock);
+
+	seq_printf(s, "%-8s %10s %14s %12s %10s\n",
+		   "op", "count", "bytes", "time_us", "max_us");
+	for (i = 0; i < ARRAY_SIZE(stats); i++)
+		seq_printf(s, "%-8s %10lu %14llu %12llu %10llu\n",
+			   cache_maint_stat_name[i], stats[i].count,
+			   stats[i].bytes, div_u64(stats[i].time_ns, 1000),
+			   div_u64(stats[i].max_ns, 1000));
+	seq_printf(s, "batches %lu\n", batches);
+	seq_printf(s, "merged_regions %lu\n", merged);
+	seq_printf(s, "whole_threshold %u\n", cache_maint_whole_threshold);
+	return 0;
+}
+
+static int cache_maint_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cache_maint_stats_show, inode->i_private);
+}
+
+static const struct file_operations cache_maint_stats_fops = {
+	.open = cache_maint_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvmap_cache_maint_debugfs_init(struct dentry *root)
+{
+	debugfs_create_file("cache_maint", 0444, root, NULL,
+			    &cache_maint_stats_fops);
+}
+
 
 int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg)
 {
@@ -470,6 +567,169 @@ out:
 	return err;
 }
 
+static int cache_region_cmp(const void *a, const void *b)
+{
+	const struct nvmap_cache_region *ra = a;
+	const struct nvmap_cache_region *rb = b;
+
+	if (ra->handle != rb->handle)
+		return ra->handle < rb->handle ? -1 : 1;
+	if (ra->op != rb->op)
+		return ra->op < rb->op ? -1 : 1;
+	if (ra->offset != rb->offset)
+		return ra->offset < rb->offset ? -1 : 1;
+	return 0;
+}
+
+/* sorts the regions by handle, op and offset, and merges overlapping or
+ * adjacent regions of the same handle and op. returns the new count */
+static unsigned int cache_region_coalesce(struct nvmap_cache_region *r,
+					  unsigned int count)
+{
+	unsigned int i, n = 0;
+
+	sort(r, count, sizeof(*r), cache_region_cmp, NULL);
+
+	for (i = 1; i < count; i++) {
+		struct nvmap_cache_region *last = &r[n];
+		u64 last_end = (u64)last->offset + last->len;
+
+		if (r[i].handle == last->handle && r[i].op == last->op &&
+		    r[i].offset <= last_end) {
+			u64 end = max_t(u64, last_end,
+					(u64)r[i].offset + r[i].len);
+			last->len = end - last->offset;
+			continue;
+		}
+		r[++n] = r[i];
+	}
+	return n + 1;
+}
+
+static inline bool cache_region_inner(struct nvmap_handle *h)
+{
+	return h->flags == NVMAP_HANDLE_CACHEABLE ||
+	       h->flags == NVMAP_HANDLE_INNER_CACHEABLE;
+}
+
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_cache_op_list op;
+	struct nvmap_cache_region *regions;
+	struct nvmap_handle **handles;
+	unsigned int i, count;
+	u64 whole_bytes = 0;
+	bool whole_flush = false;
+	bool whole;
+	int err = 0;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.count || op.count > NVMAP_CACHE_LIST_MAX)
+		return -EINVAL;
+
+	regions = kmalloc(op.count * sizeof(*regions), GFP_KERNEL);
+	handles = kcalloc(op.count, sizeof(*handles), GFP_KERNEL);
+	if (!regions || !handles) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(regions, (void __user *)op.regions,
+			   op.count * sizeof(*regions))) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < op.count; i++) {
+		if (!regions[i].handle || regions[i].op < NVMAP_CACHE_OP_WB ||
+		    regions[i].op > NVMAP_CACHE_OP_WB_INV) {
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	count = cache_region_coalesce(regions, op.count);
+
+	for (i = 0; i < count; i++) {
+		struct nvmap_cache_region *r = &regions[i];
+		struct nvmap_handle *h;
+
+		h = nvmap_get_handle_id(client, r->handle);
+		if (!h) {
+			err = -EPERM;
+			goto out_put;
+		}
+		handles[i] = h;
+
+		if (!h->alloc) {
+			err = -EFAULT;
+			goto out_put;
+		}
+		if ((u64)r->offset + r->len > h->size) {
+			nvmap_warn(client, "cache maintenance outside handle\n");
+			err = -EINVAL;
+			goto out_put;
+		}
+
+		if (r->op != NVMAP_CACHE_OP_INV && cache_region_inner(h)) {
+			whole_bytes += r->len;
+			if (r->op == NVMAP_CACHE_OP_WB_INV)
+				whole_flush = true;
+		}
+	}
+
+	/* invalidation by set/way would discard other dirty lines, so only
+	 * write-back regions count towards (and use) the whole-cache path */
+	whole = whole_bytes && whole_bytes >= cache_maint_whole_threshold;
+	if (whole) {
+		ktime_t t = ktime_get();
+
+		wmb();
+		if (whole_flush)
+			inner_flush_cache_all();
+		else
+			inner_clean_cache_all();
+		cache_maint_account(NVMAP_CACHE_OP_WB_INV + 1, whole_bytes, t);
+	}
+
+	for (i = 0; i < count && !err; i++) {
+		struct nvmap_cache_region *r = &regions[i];
+		struct nvmap_handle *h = handles[i];
+		unsigned long start = r->offset;
+		unsigned long end = start + r->len;
+
+		if (start == end)
+			continue;
+
+		if (whole && r->op != NVMAP_CACHE_OP_INV &&
+		    cache_region_inner(h)) {
+			ktime_t t = ktime_get();
+
+			outer_handle_cache_maint(client, h, start, end, r->op);
+			cache_maint_account(r->op, end - start, t);
+		} else {
+			err = cache_maint(client, h, start, end, r->op);
+		}
+	}
+
+	spin_lock(&cache_maint_stat_lock);
+	cache_maint_batches++;
+	cache_maint_merged += op.count - count;
+	spin_unlock(&cache_maint_stat_lock);
+
+out_put:
+	for (i = 0; i < count; i++)
+		if (handles[i])
+			nvmap_handle_put(handles[i]);
+out:
+	kfree(handles);
+	kfree(regions);
+	return err;
+}
+
 int nvmap_ioctl_free(struct file *filp, unsigned long arg)
 {
 	struct nvmap_client *client = filp->private_data;
@@ -535,6 +795,29 @@ static void heap_page_cache_maint(struct nvmap_client *client,
 	}
 }
 
+/* outer cache maintenance only, for when the inner cache has already been
+ * maintained as a whole */
+static void outer_handle_cache_maint(struct nvmap_client *client,
+	struct nvmap_handle *h, unsigned long start, unsigned long end,
+	unsigned int op)
+{
+	if (h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+		return;
+
+	if (h->heap_pgalloc) {
+		heap_page_cache_maint(client, h, start, end, op,
+				false, true, NULL, 0, 0);
+		return;
+	}
+
+	/* lock carveout from relocation by mapcount */
+	nvmap_usecount_inc(h);
+	start += h->carveout->base;
+	end += h->carveout->base;
+	outer_cache_maint(op, start, end - start);
+	nvmap_usecount_dec(h);
+}
+
 static bool fast_cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 	unsigned long start, unsigned long end, unsigned int op)
 {
@@ -549,21 +832,14 @@ static bool fast_cache_maint(struct nvmap_client *client, struct nvmap_handle *h
 	else if (op == NVMAP_CACHE_OP_WB)
 		inner_clean_cache_all();
 
-	if (h->heap_pgalloc && (h->flags != NVMAP_HANDLE_INNER_CACHEABLE)) {
-		heap_page_cache_maint(client, h, start, end, op,
-				false, true, NULL, 0, 0);
-	} else if (h->flags != NVMAP_HANDLE_INNER_CACHEABLE) {
-		start += h->carveout->base;
-		end += h->carveout->base;
-		outer_cache_maint(op, start, end - start);
-	}
+	outer_handle_cache_maint(client, h, start, end, op);
 	ret = true;
 out:
 	return ret;
 }
 
-static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
-		       unsigned long start, unsigned long end, unsigned int op)
+static int __cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
+			 unsigned long start, unsigned long end, unsigned int op)
 {
 	pgprot_t prot;
 	pte_t **pte = NULL;
@@ -642,6 +918,18 @@ out:
 	return err;
 }
 
+static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
+		       unsigned long start, unsigned long end, unsigned int op)
+{
+	ktime_t t = ktime_get();
+	int err;
+
+	err = __cache_maint(client, h, start, end, op);
+	if (!err && end > start)
+		cache_maint_account(op, end - start, t);
+	return err;
+}
+
 static int rw_handle_page(struct nvmap_handle *h, int is_read,
 			  phys_addr_t start, unsigned long rw_addr,
 			  unsigned long bytes, unsigned long kaddr, pte_t *pte)
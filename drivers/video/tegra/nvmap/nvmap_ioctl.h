@@ -95,6 +95,23 @@ struct nvmap_cache_op {
 	__s32 op;
 };
 
+struct nvmap_cache_region {
+	__u32 handle;		/* hmem */
+	__u32 offset;		/* offset into hmem */
+	__u32 len;		/* number of bytes to maintain */
+	__s32 op;		/* NVMAP_CACHE_OP_* */
+};
+
+struct nvmap_cache_op_list {
+	unsigned long regions;	/* array of struct nvmap_cache_region */
+	__u32 count;		/* number of entries in regions */
+};
+
+struct nvmap_buf_fd {
+	__u32 handle;		/* hmem */
+	__s32 fd;		/* shareable buffer fd */
+};
+
 #define NVMAP_IOC_MAGIC 'N'
 
 /* Creates a new memory handle. On input, the argument is the size of the new
@@ -134,7 +151,17 @@ struct nvmap_cache_op {
  * reference to the same handle */
 #define NVMAP_IOC_GET_ID  _IOWR(NVMAP_IOC_MAGIC, 13, struct nvmap_create_handle)
 
-#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_GET_ID))
+/* Performs cache maintenance on a list of handle regions. Regions are
+ * coalesced, and the inner cache is maintained by set/way once the total
+ * exceeds the cache_maint_whole_threshold module parameter */
+#define NVMAP_IOC_CACHE_LIST _IOW(NVMAP_IOC_MAGIC, 14, struct nvmap_cache_op_list)
+
+/* Exports a handle as a file descriptor which can be passed to other
+ * processes and drivers, and imports such a descriptor into this client */
+#define NVMAP_IOC_SHARE_FD _IOWR(NVMAP_IOC_MAGIC, 15, struct nvmap_buf_fd)
+#define NVMAP_IOC_FROM_FD  _IOWR(NVMAP_IOC_MAGIC, 16, struct nvmap_buf_fd)
+
+#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_FROM_FD))
 
 int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg);
 
@@ -152,6 +179,12 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_cache_maint(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg);
+
+int nvmap_ioctl_share_fd(struct file *filp, void __user *arg);
+
+int nvmap_ioctl_from_fd(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_rw_handle(struct file *filp, int is_read, void __user* arg);
 
 
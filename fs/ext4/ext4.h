@@ -27,6 +27,7 @@
 #include <linux/mutex.h>
 #include <linux/timer.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <linux/blockgroup_lock.h>
 #include <linux/percpu_counter.h>
 #ifdef __KERNEL__
@@ -626,6 +627,17 @@ struct ext4_inode {
 	__le32  i_version_hi;	/* high 32 bits for 64-bit version */
 };
 
+/*
+ * Fast commit record: the inode as it was when fsync was called.  Only its
+ * mode and timestamps are replayed.
+ */
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__le16	fc_size;	/* bytes of fc_raw which are valid */
+	__le16	fc_pad;
+	struct ext4_inode fc_raw;
+};
+
 struct move_extent {
 	__u32 reserved;		/* should be zero */
 	__u32 donor_fd;		/* donor file descriptor */
@@ -858,6 +870,11 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+	/*
+	 * Last transaction to change the inode in a way a fast commit
+	 * can't replay.
+	 */
+	tid_t i_fc_tid;
 };
 
 /*
@@ -909,6 +926,13 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+/*
+ * Mount flags kept in s_mount_opt2
+ */
+#define EXT4_MOUNT2_ERASE_ALIGN		0x00000001 /* Align to erase blocks */
+#define EXT4_MOUNT2_LAZY_DISCARD	0x00000002 /* Discard in the background */
+#define EXT4_MOUNT2_FAST_COMMIT		0x00000004 /* Fast commits for fsync */
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1154,6 +1178,7 @@ struct ext4_sb_info {
 
 	/* tunables */
 	unsigned long s_stripe;
+	unsigned int s_erase_blocks;	/* flash erase block, in blocks */
 	unsigned int s_mb_stream_request;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
@@ -1201,6 +1226,18 @@ struct ext4_sb_info {
 	struct ext4_li_request *s_li_request;
 	/* Wait multiplier for lazy initialization thread */
 	unsigned int s_li_wait_mult;
+
+	/* freed extents waiting for a lazy discard, in group order */
+	spinlock_t s_discard_lock;
+	struct rb_root s_discard_root;
+	unsigned long s_discard_pending;	/* in blocks */
+	struct delayed_work s_discard_work;
+	unsigned long s_discard_last_ios;
+	unsigned int s_discard_idle_ms;
+	unsigned int s_discard_slice_ms;
+	unsigned int s_discard_kbs;		/* measured throughput */
+	u64 s_discard_kbytes;
+	u64 s_discard_msecs;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1669,6 +1706,9 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
 extern int ext4_flush_completed_IO(struct inode *);
+extern void ext4_fc_copy_fields(struct ext4_inode *, const struct ext4_inode *,
+				int);
+extern int ext4_fc_replay(journal_t *, const void *, int);
 
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
@@ -28,6 +28,7 @@
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/slab.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -151,6 +152,155 @@ static int ext4_sync_parent(struct inode *inode)
 	return ret;
 }
 
+/*
+ * Does the inode table entry fit @field, in the @size bytes of it we have?
+ */
+#define EXT4_FC_FITS(raw_inode, field, size)				\
+	((size) > EXT4_GOOD_OLD_INODE_SIZE &&				\
+	 offsetof(struct ext4_inode, field) + sizeof((raw_inode)->field) <=	\
+	 min_t(int, (size), EXT4_GOOD_OLD_INODE_SIZE +			\
+	       le16_to_cpu((raw_inode)->i_extra_isize)))
+
+/*
+ * Copies the fields a fast commit replays from @src to @dst, the first
+ * @size bytes of inode table entries of the same inode.
+ */
+void ext4_fc_copy_fields(struct ext4_inode *dst, const struct ext4_inode *src,
+			 int size)
+{
+	dst->i_mode = src->i_mode;
+	dst->i_atime = src->i_atime;
+	dst->i_ctime = src->i_ctime;
+	dst->i_mtime = src->i_mtime;
+	if (EXT4_FC_FITS(dst, i_ctime_extra, size))
+		dst->i_ctime_extra = src->i_ctime_extra;
+	if (EXT4_FC_FITS(dst, i_mtime_extra, size))
+		dst->i_mtime_extra = src->i_mtime_extra;
+	if (EXT4_FC_FITS(dst, i_atime_extra, size))
+		dst->i_atime_extra = src->i_atime_extra;
+}
+
+/*
+ * Can fsync make the inode durable with a fast commit?  Everything but
+ * the fields ext4_fc_copy_fields() handles, and the blocks of the file,
+ * must be in committed transactions already.  The caller has written
+ * the file data.
+ */
+static int ext4_fc_eligible(struct inode *inode, journal_t *journal)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	tid_t commit_sequence = journal->j_commit_sequence;
+
+	if (!test_opt2(inode->i_sb, FAST_COMMIT) ||
+	    !jbd2_journal_check_available_features(journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+	if (!S_ISREG(inode->i_mode) || ext4_should_journal_data(inode))
+		return 0;
+	/* nothing to commit anyway */
+	if (tid_geq(commit_sequence, ei->i_sync_tid))
+		return 0;
+	return tid_geq(commit_sequence, ei->i_datasync_tid) &&
+		tid_geq(commit_sequence, ei->i_fc_tid);
+}
+
+/*
+ * Logs the inode on its own.  Returns -EAGAIN if the running transaction
+ * has to commit instead.
+ */
+static int ext4_fc_commit(struct inode *inode, journal_t *journal)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_fc_inode *fc;
+	struct ext4_iloc iloc;
+	handle_t *handle;
+	int size, ret, err;
+
+	fc = kzalloc(sizeof(*fc), GFP_NOFS);
+	if (!fc)
+		return -EAGAIN;
+
+	handle = ext4_journal_start(inode, 1);
+	if (IS_ERR(handle)) {
+		ret = PTR_ERR(handle);
+		goto out_free;
+	}
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		goto out_stop;
+	size = min_t(int, EXT4_INODE_SIZE(inode->i_sb), sizeof(fc->fc_raw));
+	memcpy(&fc->fc_raw, ext4_raw_inode(&iloc), size);
+	brelse(iloc.bh);
+	fc->fc_ino = cpu_to_le32(inode->i_ino);
+	fc->fc_size = cpu_to_le16(size);
+
+	/*
+	 * The inode must have changed in the transaction we are in, and
+	 * only in ways we record, since it was checked.
+	 */
+	ret = -EAGAIN;
+	if (ei->i_sync_tid != handle->h_transaction->t_tid ||
+	    !ext4_fc_eligible(inode, journal))
+		goto out_stop;
+
+	ret = jbd2_journal_fast_commit(handle, fc, sizeof(*fc));
+out_stop:
+	err = ext4_journal_stop(handle);
+	if (!ret)
+		ret = err;
+out_free:
+	kfree(fc);
+	return ret;
+}
+
+/*
+ * Called by jbd2 during recovery, with a record ext4_fc_commit() wrote
+ * in a transaction which did not commit.
+ */
+int ext4_fc_replay(journal_t *journal, const void *data, int len)
+{
+	struct super_block *sb = journal->j_private;
+	const struct ext4_fc_inode *fc = data;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	struct ext4_inode *raw_inode;
+	unsigned long ino;
+	ext4_group_t group;
+	ext4_fsblk_t block;
+	unsigned long inodes_per_block = EXT4_SB(sb)->s_inodes_per_block;
+	int offset, size;
+
+	if (len < sizeof(*fc))
+		return -EIO;
+	ino = le32_to_cpu(fc->fc_ino);
+	size = le16_to_cpu(fc->fc_size);
+	if (!ext4_valid_inum(sb, ino) || size > sizeof(fc->fc_raw) ||
+	    size > EXT4_INODE_SIZE(sb)) {
+		ext4_msg(sb, KERN_ERR, "bad fast commit for inode %lu", ino);
+		return -EIO;
+	}
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	offset = (ino - 1) % EXT4_INODES_PER_GROUP(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+	block = ext4_inode_table(sb, gdp) + offset / inodes_per_block;
+
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	lock_buffer(bh);
+	raw_inode = (struct ext4_inode *)(bh->b_data +
+		(offset % inodes_per_block) * EXT4_INODE_SIZE(sb));
+	ext4_fc_copy_fields(raw_inode, &fc->fc_raw, size);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
 /*
  * akpm: A new design for ext4_sync_file().
  *
@@ -210,6 +360,16 @@ int ext4_sync_file(struct file *file, int datasync)
 		goto out;
 	}
 
+	/*
+	 * Only the inode's mode or timestamps changed since the last
+	 * commit: log just those.
+	 */
+	if (!datasync && ext4_fc_eligible(inode, journal)) {
+		ret = ext4_fc_commit(inode, journal);
+		if (ret != -EAGAIN)
+			goto out;
+	}
+
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
 	if (jbd2_log_start_commit(journal, commit_tid)) {
 		/*
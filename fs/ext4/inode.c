@@ -4910,6 +4910,7 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		ei->i_fc_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
@@ -5062,11 +5063,19 @@ static int ext4_do_update_inode(handle_t *handle,
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	struct buffer_head *bh = iloc->bh;
 	int err = 0, rc, block;
+	int fc_size = 0;
+	struct ext4_inode old;
 
 	/* For fields not not tracking in the in-memory inode,
 	 * initialise them to zero for new inodes. */
 	if (ext4_test_inode_state(inode, EXT4_STATE_NEW))
 		memset(raw_inode, 0, EXT4_SB(inode->i_sb)->s_inode_size);
+	else if (test_opt2(inode->i_sb, FAST_COMMIT)) {
+		/* to tell whether a fast commit can record the change */
+		fc_size = min_t(int, EXT4_INODE_SIZE(inode->i_sb),
+				sizeof(old));
+		memcpy(&old, raw_inode, fc_size);
+	}
 
 	ext4_get_inode_flags(ei);
 	raw_inode->i_mode = cpu_to_le16(inode->i_mode);
@@ -5157,6 +5166,13 @@ static int ext4_do_update_inode(handle_t *handle,
 		raw_inode->i_extra_isize = cpu_to_le16(ei->i_extra_isize);
 	}
 
+	if (fc_size) {
+		ext4_fc_copy_fields(&old, raw_inode, fc_size);
+		if (memcmp(&old, raw_inode, fc_size))
+			ext4_fc_mark_ineligible(handle, inode);
+	} else
+		ext4_fc_mark_ineligible(handle, inode);
+
 	BUFFER_TRACE(bh, "call ext4_handle_dirty_metadata");
 	rc = ext4_handle_dirty_metadata(handle, NULL, bh);
 	if (!err)
@@ -5301,6 +5317,8 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 			inode->i_uid = attr->ia_uid;
 		if (attr->ia_valid & ATTR_GID)
 			inode->i_gid = attr->ia_gid;
+		/* the quota transfer must commit with the new owner */
+		ext4_fc_mark_ineligible(handle, inode);
 		error = ext4_mark_inode_dirty(handle, inode);
 		ext4_journal_stop(handle);
 	}
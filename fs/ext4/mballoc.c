@@ -356,6 +356,10 @@ static void ext4_mb_generate_from_pa(struct super_block *sb, void *bitmap,
 static void ext4_mb_generate_from_freelist(struct super_block *sb, void *bitmap,
 						ext4_group_t group);
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn);
+static void ext4_lazy_discard_add(struct super_block *sb, ext4_group_t group,
+				  ext4_grpblk_t start, ext4_grpblk_t count);
+static void ext4_lazy_discard_work(struct work_struct *work);
+static void ext4_lazy_discard_stop(struct super_block *sb);
 
 static inline void *mb_correct_addr_and_bit(int *bit, void *addr)
 {
@@ -1761,6 +1765,28 @@ int ext4_mb_try_best_found(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Blocks per flash erase block if the file system was mounted with
+ * erase_align and the size is known, 0 otherwise.
+ */
+static inline unsigned int ext4_mb_erase_blocks(struct super_block *sb)
+{
+	if (!test_opt2(sb, ERASE_ALIGN))
+		return 0;
+	return ACCESS_ONCE(EXT4_SB(sb)->s_erase_blocks);
+}
+
+/*
+ * Alignment the allocator tries to give requests which are a multiple of
+ * it: the RAID stripe, or else the flash erase block.
+ */
+static inline unsigned long ext4_mb_stripe(struct super_block *sb)
+{
+	if (EXT4_SB(sb)->s_stripe)
+		return EXT4_SB(sb)->s_stripe;
+	return ext4_mb_erase_blocks(sb);
+}
+
 static noinline_for_stack
 int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 				struct ext4_buddy *e4b)
@@ -1768,7 +1794,7 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	ext4_group_t group = ac->ac_g_ex.fe_group;
 	int max;
 	int err;
-	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	unsigned long stripe = ext4_mb_stripe(ac->ac_sb);
 	struct ext4_free_extent ex;
 
 	if (!(ac->ac_flags & EXT4_MB_HINT_TRY_GOAL))
@@ -1782,13 +1808,13 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == stripe) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, stripe) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1920,15 +1946,14 @@ void ext4_mb_complex_scan_group(struct ext4_allocation_context *ac,
 }
 
 /*
- * This is a special case for storages like raid5
+ * This is a special case for storages like raid5 and flash
  * we try to find stripe-aligned chunks for stripe-size-multiple requests
  */
 static noinline_for_stack
 void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
-				 struct ext4_buddy *e4b)
+				 struct ext4_buddy *e4b, unsigned long stripe)
 {
 	struct super_block *sb = ac->ac_sb;
-	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
 	ext4_fsblk_t first_group_block;
@@ -1936,26 +1961,26 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	ext4_grpblk_t i;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(stripe == 0);
 
 	/* find first stripe-aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + stripe - 1;
+	do_div(a, stripe);
+	i = (a * stripe) - first_group_block;
 
 	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, stripe, &ex);
+			if (max >= stripe) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += stripe;
 	}
 }
 
@@ -2023,9 +2048,11 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
 	struct ext4_buddy e4b;
+	unsigned long stripe;
 
 	sb = ac->ac_sb;
 	sbi = EXT4_SB(sb);
+	stripe = ext4_mb_stripe(sb);
 	ngroups = ext4_get_groups_count(sb);
 	/* non-extent files are limited to low blocks/groups */
 	if (!(ext4_test_inode_flag(ac->ac_inode, EXT4_INODE_EXTENTS)))
@@ -2112,9 +2139,9 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
+			else if (cr == 1 && stripe &&
+					!(ac->ac_g_ex.fe_len % stripe))
+				ext4_mb_scan_aligned(ac, &e4b, stripe);
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
 
@@ -2254,6 +2281,80 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+/*
+ * /proc/fs/ext4/<partition>/mb_erase_frag: how the free space is spread
+ * over the flash erase blocks. An erase block which is partly in use has
+ * to be garbage collected by the device before it can be rewritten.
+ */
+static int ext4_mb_seq_erase_frag_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	unsigned int erase = EXT4_SB(sb)->s_erase_blocks;
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	unsigned long nr_free = 0, nr_partial = 0, nr_full = 0;
+	unsigned long partial_free = 0;
+	unsigned long hist[4] = { 0, };
+	struct ext4_buddy e4b;
+	ext4_group_t group;
+	ext4_grpblk_t i, j;
+	unsigned int free;
+
+	if (!erase) {
+		seq_printf(seq, "erase block size unknown\n");
+		return 0;
+	}
+
+	for (group = 0; group < ngroups; group++) {
+		if (ext4_mb_load_buddy(sb, group, &e4b)) {
+			seq_printf(seq, "#%-5u: I/O error\n", group);
+			continue;
+		}
+		ext4_lock_group(sb, group);
+		for (i = 0; i + erase <= EXT4_BLOCKS_PER_GROUP(sb);
+		     i += erase) {
+			free = 0;
+			for (j = i; j < i + erase; j++)
+				if (!mb_test_bit(j, e4b.bd_bitmap))
+					free++;
+			if (free == erase) {
+				nr_free++;
+			} else if (free == 0) {
+				nr_full++;
+			} else {
+				nr_partial++;
+				partial_free += free;
+				hist[free * 4 / erase]++;
+			}
+		}
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(&e4b);
+		cond_resched();
+	}
+
+	seq_printf(seq, "erase block:     %u blocks\n", erase);
+	seq_printf(seq, "free:            %lu\n", nr_free);
+	seq_printf(seq, "full:            %lu\n", nr_full);
+	seq_printf(seq, "partial:         %lu (%lu free blocks)\n",
+		   nr_partial, partial_free);
+	seq_printf(seq, "partial by free space: "
+		   "<25%%: %lu  <50%%: %lu  <75%%: %lu  <100%%: %lu\n",
+		   hist[0], hist[1], hist[2], hist[3]);
+	return 0;
+}
+
+static int ext4_mb_seq_erase_frag_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_erase_frag_show, PDE(inode)->data);
+}
+
+static const struct file_operations ext4_mb_seq_erase_frag_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_erase_frag_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2533,6 +2634,13 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
 
+	spin_lock_init(&sbi->s_discard_lock);
+	sbi->s_discard_root = RB_ROOT;
+	INIT_DELAYED_WORK(&sbi->s_discard_work, ext4_lazy_discard_work);
+	sbi->s_discard_idle_ms = MB_DEFAULT_DISCARD_IDLE_MS;
+	sbi->s_discard_slice_ms = MB_DEFAULT_DISCARD_SLICE_MS;
+	sbi->s_discard_kbs = MB_DEFAULT_DISCARD_KBS;
+
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
 		ret = -ENOMEM;
@@ -2547,9 +2655,12 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_erase_frag", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_erase_frag_fops, sb);
+	}
 
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
@@ -2588,6 +2699,8 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
+	ext4_lazy_discard_stop(sb);
+
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
 			grinfo = ext4_get_group_info(sb, i);
@@ -2635,8 +2748,10 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
+		remove_proc_entry("mb_erase_frag", sbi->s_proc);
 		remove_proc_entry("mb_groups", sbi->s_proc);
+	}
 
 	return 0;
 }
@@ -2702,6 +2817,9 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 			page_cache_release(e4b.bd_bitmap_page);
 		}
 		ext4_unlock_group(sb, entry->group);
+		if (!test_opt(sb, DISCARD) && test_opt2(sb, LAZY_DISCARD))
+			ext4_lazy_discard_add(sb, entry->group,
+					      entry->start_blk, entry->count);
 		kmem_cache_free(ext4_free_ext_cachep, entry);
 		ext4_mb_unload_buddy(&e4b);
 	}
@@ -2897,7 +3015,9 @@ out_err:
 /*
  * here we normalize request for locality group
  * Group request are normalized to s_strip size if we set the same via mount
- * option. If not we set it to s_mb_group_prealloc which can be configured via
+ * option, or to the erase block size with erase_align, so that the small
+ * files of a locality group are packed into whole erase blocks. If not we
+ * set it to s_mb_group_prealloc which can be configured via
  * /sys/fs/ext4/<partition>/mb_group_prealloc
  *
  * XXX: should we try to preallocate more than the group has now?
@@ -2906,10 +3026,11 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 {
 	struct super_block *sb = ac->ac_sb;
 	struct ext4_locality_group *lg = ac->ac_lg;
+	unsigned long stripe = ext4_mb_stripe(sb);
 
 	BUG_ON(lg == NULL);
-	if (EXT4_SB(sb)->s_stripe)
-		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_stripe;
+	if (stripe)
+		ac->ac_g_ex.fe_len = stripe;
 	else
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
@@ -2926,6 +3047,7 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 {
 	int bsbits, max;
 	ext4_lblk_t end;
+	unsigned int erase;
 	loff_t size, orig_size, start_off;
 	ext4_lblk_t start;
 	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
@@ -3003,6 +3125,23 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	size = size >> bsbits;
 	start = start_off >> bsbits;
 
+	/*
+	 * On flash, round the window out to whole erase blocks of the file,
+	 * so that the preallocation fills erase blocks one after the other
+	 * instead of leaving them partly used.
+	 */
+	erase = ext4_mb_erase_blocks(ac->ac_sb);
+	if (erase) {
+		ext4_lblk_t estart = start & ~(erase - 1);
+		ext4_lblk_t eend = (start + size + erase - 1) & ~(erase - 1);
+
+		if (eend > estart &&
+		    eend - estart <= EXT4_BLOCKS_PER_GROUP(ac->ac_sb)) {
+			start = estart;
+			size = eend - estart;
+		}
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -4743,6 +4882,252 @@ static int ext4_trim_extent(struct super_block *sb, int start, int count,
 	return ret;
 }
 
+/*
+ * Lazy discard
+ *
+ * With the lazy_discard mount option, the extents freed by a commit are not
+ * discarded right away, which would stall the commit, but queued in
+ * s_discard_root, where adjacent extents are merged. A worker discards them
+ * once the device has seen no I/O for s_discard_idle_ms, for at most
+ * s_discard_slice_ms at a time, and stops as soon as other I/O shows up.
+ * Extents are cut to what the device can discard in a slice, going by its
+ * measured throughput.
+ *
+ * The blocks are back in the buddy by then and may have been reused, so
+ * only the parts still free are discarded, marked used meanwhile like
+ * FITRIM does.
+ */
+static void ext4_lazy_discard_merge(struct ext4_sb_info *sbi,
+				    struct ext4_discard_extent *de,
+				    struct ext4_discard_extent *next)
+{
+	ext4_grpblk_t end = max(de->start + de->count,
+				next->start + next->count);
+
+	sbi->s_discard_pending -= de->count + next->count;
+	de->count = end - de->start;
+	sbi->s_discard_pending += de->count;
+	rb_erase(&next->node, &sbi->s_discard_root);
+	kfree(next);
+}
+
+static void ext4_lazy_discard_insert(struct ext4_sb_info *sbi,
+				     struct ext4_discard_extent *new)
+{
+	struct rb_node **n = &sbi->s_discard_root.rb_node;
+	struct rb_node *parent = NULL, *node;
+	struct ext4_discard_extent *de;
+
+	while (*n) {
+		parent = *n;
+		de = rb_entry(parent, struct ext4_discard_extent, node);
+		if (new->group < de->group ||
+		    (new->group == de->group && new->start < de->start))
+			n = &(*n)->rb_left;
+		else
+			n = &(*n)->rb_right;
+	}
+	rb_link_node(&new->node, parent, n);
+	rb_insert_color(&new->node, &sbi->s_discard_root);
+	sbi->s_discard_pending += new->count;
+
+	node = rb_prev(&new->node);
+	if (node) {
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		if (de->group == new->group &&
+		    de->start + de->count >= new->start) {
+			ext4_lazy_discard_merge(sbi, de, new);
+			new = de;
+		}
+	}
+	while ((node = rb_next(&new->node))) {
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		if (de->group != new->group ||
+		    new->start + new->count < de->start)
+			break;
+		ext4_lazy_discard_merge(sbi, new, de);
+	}
+}
+
+static void ext4_lazy_discard_queue(struct ext4_sb_info *sbi)
+{
+	/* at least a tick, or a busy device keeps the worker spinning */
+	queue_delayed_work(system_long_wq, &sbi->s_discard_work,
+			   msecs_to_jiffies(sbi->s_discard_idle_ms) ?: 1);
+}
+
+static void ext4_lazy_discard_add(struct super_block *sb, ext4_group_t group,
+				  ext4_grpblk_t start, ext4_grpblk_t count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_discard_extent *new;
+
+	/* a discard is only a hint, don't fail the commit for it */
+	new = kmalloc(sizeof(*new), GFP_NOFS);
+	if (!new)
+		return;
+	new->group = group;
+	new->start = start;
+	new->count = count;
+
+	spin_lock(&sbi->s_discard_lock);
+	ext4_lazy_discard_insert(sbi, new);
+	spin_unlock(&sbi->s_discard_lock);
+
+	ext4_lazy_discard_queue(sbi);
+}
+
+static void ext4_lazy_discard_drop(struct ext4_sb_info *sbi)
+{
+	struct ext4_discard_extent *de;
+	struct rb_node *node;
+
+	spin_lock(&sbi->s_discard_lock);
+	while ((node = rb_first(&sbi->s_discard_root))) {
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		rb_erase(node, &sbi->s_discard_root);
+		kfree(de);
+	}
+	sbi->s_discard_pending = 0;
+	spin_unlock(&sbi->s_discard_lock);
+}
+
+static void ext4_lazy_discard_stop(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	cancel_delayed_work_sync(&sbi->s_discard_work);
+	ext4_lazy_discard_drop(sbi);
+}
+
+/* Discards the still free parts of an extent, returns the blocks discarded */
+static int ext4_lazy_discard_extent(struct super_block *sb, ext4_group_t group,
+				    ext4_grpblk_t start, ext4_grpblk_t count)
+{
+	struct ext4_buddy e4b;
+	ext4_grpblk_t end = start + count, next;
+	int discarded = 0;
+	int ret;
+
+	ret = ext4_mb_load_buddy(sb, group, &e4b);
+	if (ret)
+		return ret;
+
+	ext4_lock_group(sb, group);
+	while (start < end) {
+		start = mb_find_next_zero_bit(e4b.bd_bitmap, end, start);
+		if (start >= end)
+			break;
+		next = mb_find_next_bit(e4b.bd_bitmap, end, start);
+		ret = ext4_trim_extent(sb, start, next - start, group, &e4b);
+		if (ret < 0)
+			break;
+		discarded += next - start;
+		start = next + 1;
+	}
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+
+	return ret < 0 ? ret : discarded;
+}
+
+static unsigned long ext4_lazy_discard_ios(struct hd_struct *part)
+{
+	return part_stat_read(part, ios[READ]) + part_stat_read(part, ios[WRITE]);
+}
+
+static void ext4_lazy_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+					struct ext4_sb_info, s_discard_work);
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	struct hd_struct *part = sb->s_bdev->bd_part;
+	struct ext4_discard_extent *de;
+	struct rb_node *node;
+	unsigned long start, ios, msecs;
+	ext4_grpblk_t chunk, len;
+	u64 kbytes, blocks = 0;
+	int ret;
+
+	if (!test_opt2(sb, LAZY_DISCARD) || !part) {
+		ext4_lazy_discard_drop(sbi);
+		return;
+	}
+
+	/* wait until the device has been idle for a whole period */
+	ios = ext4_lazy_discard_ios(part);
+	if (ios != sbi->s_discard_last_ios || part_in_flight(part)) {
+		sbi->s_discard_last_ios = ios;
+		goto again;
+	}
+
+	/* what the device discards in a slice, at least a megabyte */
+	kbytes = div_u64((u64)sbi->s_discard_kbs * sbi->s_discard_slice_ms,
+			 MSEC_PER_SEC);
+	kbytes = max_t(u64, kbytes, 1024);
+	chunk = min_t(u64, kbytes >> (sb->s_blocksize_bits - 10),
+		      EXT4_BLOCKS_PER_GROUP(sb));
+
+	start = jiffies;
+	do {
+		ext4_group_t group;
+		ext4_grpblk_t first;
+
+		spin_lock(&sbi->s_discard_lock);
+		node = rb_first(&sbi->s_discard_root);
+		if (!node) {
+			spin_unlock(&sbi->s_discard_lock);
+			break;
+		}
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		rb_erase(node, &sbi->s_discard_root);
+		sbi->s_discard_pending -= de->count;
+		group = de->group;
+		first = de->start;
+		len = min(de->count, chunk);
+		if (len < de->count) {
+			/* the rest waits for the next slice */
+			de->start += len;
+			de->count -= len;
+			ext4_lazy_discard_insert(sbi, de);
+			de = NULL;
+		}
+		spin_unlock(&sbi->s_discard_lock);
+		kfree(de);
+
+		ret = ext4_lazy_discard_extent(sb, group, first, len);
+		if (ret == -EOPNOTSUPP) {
+			ext4_warning(sb, "discard not supported, "
+					 "disabling lazy discard");
+			clear_opt2(sb, LAZY_DISCARD);
+			ext4_lazy_discard_drop(sbi);
+			break;
+		}
+		if (ret > 0)
+			blocks += ret;
+	} while (!part_in_flight(part) &&
+		 time_before(jiffies, start +
+			     msecs_to_jiffies(sbi->s_discard_slice_ms)));
+
+	msecs = jiffies_to_msecs(jiffies - start);
+	kbytes = blocks << (sb->s_blocksize_bits - 10);
+	sbi->s_discard_kbytes += kbytes;
+	sbi->s_discard_msecs += msecs;
+	if (kbytes && msecs) {
+		u64 kbs = div_u64(kbytes * MSEC_PER_SEC, msecs);
+
+		/* average the throughput over the last few slices */
+		sbi->s_discard_kbs = (sbi->s_discard_kbs * 3 +
+				      min_t(u64, kbs, UINT_MAX / 4)) / 4;
+	}
+	/* our own discards don't make the device busy */
+	sbi->s_discard_last_ios = ext4_lazy_discard_ios(part);
+
+again:
+	if (sbi->s_discard_pending)
+		ext4_lazy_discard_queue(sbi);
+}
+
 /**
  * ext4_trim_all_free -- function to trim all free space in alloc. group
  * @sb:			super block for file system
@@ -94,6 +94,15 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * lazy discard: the device must have been idle for this long, the worker
+ * then discards for at most a slice at a time. The throughput is a first
+ * guess until the device's is measured.
+ */
+#define MB_DEFAULT_DISCARD_IDLE_MS	1000
+#define MB_DEFAULT_DISCARD_SLICE_MS	100
+#define MB_DEFAULT_DISCARD_KBS		(64 * 1024)
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -113,6 +122,14 @@ struct ext4_free_data {
 	tid_t	t_tid;
 };
 
+/* freed extent waiting for a lazy discard */
+struct ext4_discard_extent {
+	struct rb_node node;
+	ext4_group_t group;
+	ext4_grpblk_t start;
+	ext4_grpblk_t count;
+};
+
 struct ext4_prealloc_space {
 	struct list_head	pa_inode_list;
 	struct list_head	pa_group_list;
@@ -850,6 +850,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->cur_aio_dio = NULL;
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_fc_tid = 0;
 	atomic_set(&ei->i_ioend_count, 0);
 	atomic_set(&ei->i_aiodio_unwritten, 0);
 
@@ -1060,6 +1061,12 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_puts(seq, ",nomblk_io_submit");
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (test_opt2(sb, ERASE_ALIGN))
+		seq_puts(seq, ",erase_align");
+	if (test_opt2(sb, LAZY_DISCARD))
+		seq_puts(seq, ",lazy_discard");
+	if (test_opt2(sb, FAST_COMMIT))
+		seq_puts(seq, ",fast_commit");
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -1277,6 +1284,9 @@ enum {
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard,
 	Opt_init_inode_table, Opt_noinit_inode_table,
+	Opt_erase_align, Opt_noerase_align,
+	Opt_lazy_discard, Opt_nolazy_discard,
+	Opt_fast_commit, Opt_nofast_commit,
 };
 
 static const match_table_t tokens = {
@@ -1352,6 +1362,12 @@ static const match_table_t tokens = {
 	{Opt_init_inode_table, "init_itable=%u"},
 	{Opt_init_inode_table, "init_itable"},
 	{Opt_noinit_inode_table, "noinit_itable"},
+	{Opt_erase_align, "erase_align"},
+	{Opt_noerase_align, "noerase_align"},
+	{Opt_lazy_discard, "lazy_discard"},
+	{Opt_nolazy_discard, "nolazy_discard"},
+	{Opt_fast_commit, "fast_commit"},
+	{Opt_nofast_commit, "nofast_commit"},
 	{Opt_err, NULL},
 };
 
@@ -1822,6 +1838,24 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sb, DISCARD);
 			break;
+		case Opt_erase_align:
+			set_opt2(sb, ERASE_ALIGN);
+			break;
+		case Opt_noerase_align:
+			clear_opt2(sb, ERASE_ALIGN);
+			break;
+		case Opt_lazy_discard:
+			set_opt2(sb, LAZY_DISCARD);
+			break;
+		case Opt_nolazy_discard:
+			clear_opt2(sb, LAZY_DISCARD);
+			break;
+		case Opt_fast_commit:
+			set_opt2(sb, FAST_COMMIT);
+			break;
+		case Opt_nofast_commit:
+			clear_opt2(sb, FAST_COMMIT);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sb, DIOREAD_NOLOCK);
 			break;
@@ -2369,6 +2403,34 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return 0;
 }
 
+/**
+ * ext4_get_erase_blocks: Get the flash erase block size.
+ * @sb: super block
+ *
+ * Returns the erase block size of the device in file system blocks, taken
+ * from its optimal I/O size or else its discard granularity, or 0 if the
+ * device doesn't report one the allocator can use: it must be a power of
+ * 2 and not larger than a block group.
+ */
+static unsigned int ext4_get_erase_blocks(struct super_block *sb)
+{
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	unsigned int blocks;
+
+	if (!q)
+		return 0;
+
+	blocks = queue_io_opt(q) >> sb->s_blocksize_bits;
+	if (!blocks)
+		blocks = q->limits.discard_granularity >> sb->s_blocksize_bits;
+
+	if (blocks <= 1 || !is_power_of_2(blocks) ||
+	    blocks > EXT4_BLOCKS_PER_GROUP(sb))
+		return 0;
+
+	return blocks;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2425,6 +2487,37 @@ static ssize_t lifetime_write_kbytes_show(struct ext4_attr *a,
 			  EXT4_SB(sb)->s_sectors_written_start) >> 1)));
 }
 
+static ssize_t lazy_discard_pending_kbytes_show(struct ext4_attr *a,
+					       struct ext4_sb_info *sbi,
+					       char *buf)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)sbi->s_discard_pending <<
+			(sb->s_blocksize_bits - 10));
+}
+
+static ssize_t lazy_discard_kbytes_show(struct ext4_attr *a,
+					struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)sbi->s_discard_kbytes);
+}
+
+static ssize_t lazy_discard_ms_show(struct ext4_attr *a,
+				    struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)sbi->s_discard_msecs);
+}
+
+static ssize_t lazy_discard_kbs_show(struct ext4_attr *a,
+				     struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", sbi->s_discard_kbs);
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2441,6 +2534,22 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t mb_erase_blocks_store(struct ext4_attr *a,
+				     struct ext4_sb_info *sbi,
+				     const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (parse_strtoul(buf, sbi->s_blocks_per_group, &t))
+		return -EINVAL;
+
+	if (t == 1 || (t && !is_power_of_2(t)))
+		return -EINVAL;
+
+	sbi->s_erase_blocks = t;
+	return count;
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2491,7 +2600,15 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_ATTR_OFFSET(mb_erase_blocks, 0644, sbi_ui_show,
+		 mb_erase_blocks_store, s_erase_blocks);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_RW_ATTR_SBI_UI(lazy_discard_idle_ms, s_discard_idle_ms);
+EXT4_RW_ATTR_SBI_UI(lazy_discard_slice_ms, s_discard_slice_ms);
+EXT4_RO_ATTR(lazy_discard_pending_kbytes);
+EXT4_RO_ATTR(lazy_discard_kbytes);
+EXT4_RO_ATTR(lazy_discard_ms);
+EXT4_RO_ATTR(lazy_discard_kbs);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2505,7 +2622,14 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_erase_blocks),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(lazy_discard_idle_ms),
+	ATTR_LIST(lazy_discard_slice_ms),
+	ATTR_LIST(lazy_discard_pending_kbytes),
+	ATTR_LIST(lazy_discard_kbytes),
+	ATTR_LIST(lazy_discard_ms),
+	ATTR_LIST(lazy_discard_kbs),
 	NULL,
 };
 
@@ -3414,6 +3538,16 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	sbi->s_erase_blocks = ext4_get_erase_blocks(sb);
+	if (test_opt2(sb, ERASE_ALIGN)) {
+		if (!sbi->s_erase_blocks)
+			ext4_msg(sb, KERN_WARNING, "erase_align: device "
+				 "reports no usable erase block size");
+		else if (get_start_sect(sb->s_bdev) &
+			 ((sbi->s_erase_blocks << (sb->s_blocksize_bits - 9)) - 1))
+			ext4_msg(sb, KERN_WARNING, "erase_align: partition "
+				 "does not start on an erase block");
+	}
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -3921,6 +4055,7 @@ static int ext4_load_journal(struct super_block *sb,
 		if (!(journal = ext4_get_dev_journal(sb, journal_dev)))
 			return -EINVAL;
 	}
+	journal->j_fc_replay = ext4_fc_replay;
 
 	if (!(journal->j_flags & JBD2_BARRIER))
 		ext4_msg(sb, KERN_INFO, "barriers disabled");
@@ -497,7 +497,10 @@ int jbd2_cleanup_journal_tail(journal_t *journal)
 		blocknr = transaction->t_log_start;
 	} else if ((transaction = journal->j_running_transaction) != NULL) {
 		first_tid = transaction->t_tid;
-		blocknr = journal->j_head;
+		/* keep its fast commits, if there are any */
+		blocknr = transaction->t_log_start;
+		if (!blocknr)
+			blocknr = journal->j_head;
 	} else {
 		first_tid = journal->j_transaction_sequence;
 		blocknr = journal->j_head;
@@ -528,6 +531,12 @@ int jbd2_cleanup_journal_tail(journal_t *journal)
 	journal->j_free += freed;
 	journal->j_tail_sequence = first_tid;
 	journal->j_tail = blocknr;
+	/* the log holds no fast commit anymore */
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    tid_gt(first_tid, journal->j_fc_tid))
+		jbd2_journal_clear_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
 	write_unlock(&journal->j_state_lock);
 
 	/*
@@ -43,6 +43,18 @@ static void journal_end_buffer_io_sync(struct buffer_head *bh, int uptodate)
 	unlock_buffer(bh);
 }
 
+/*
+ * Microseconds since *start, which is moved on to now.
+ */
+static u32 jbd2_phase_us(ktime_t *start)
+{
+	ktime_t now = ktime_get();
+	u32 us = ktime_to_us(ktime_sub(now, *start));
+
+	*start = now;
+	return us;
+}
+
 /*
  * When an ext4 file is truncated, it is possible that some pages are not
  * successfully freed, because they are attached to a committing transaction.
@@ -312,6 +324,7 @@ static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 void jbd2_journal_commit_transaction(journal_t *journal)
 {
 	struct transaction_stats_s stats;
+	struct transaction_phase_stats_s phases;
 	transaction_t *commit_transaction;
 	struct journal_head *jh, *new_jh, *descriptor;
 	struct buffer_head **wbuf = journal->j_wbuf;
@@ -319,7 +332,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
+	ktime_t start_time, phase_start;
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_header_t *header;
@@ -368,6 +381,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
 	stats.run.rs_locked = jiffies;
+	phase_start = ktime_get();
 	stats.run.rs_running = jbd2_time_diff(commit_transaction->t_start,
 					      stats.run.rs_locked);
 
@@ -450,7 +464,10 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	journal->j_committing_transaction = commit_transaction;
 	journal->j_running_transaction = NULL;
 	start_time = ktime_get();
-	commit_transaction->t_log_start = journal->j_head;
+	phases.ps_locked = jbd2_phase_us(&phase_start);
+	/* Fast commits may already have started the transaction in the log */
+	if (!commit_transaction->t_log_start)
+		commit_transaction->t_log_start = journal->j_head;
 	wake_up(&journal->j_wait_transaction_locked);
 	write_unlock(&journal->j_state_lock);
 
@@ -468,6 +485,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	jbd2_journal_write_revoke_records(journal, commit_transaction,
 					  WRITE_SYNC);
 	blk_finish_plug(&plug);
+	phases.ps_data = jbd2_phase_us(&phase_start);
 
 	jbd_debug(3, "JBD: commit phase 2\n");
 
@@ -668,6 +686,8 @@ start_journal_io:
 		}
 	}
 
+	phases.ps_log = jbd2_phase_us(&phase_start);
+
 	err = journal_finish_inode_data_buffers(journal, commit_transaction);
 	if (err) {
 		printk(KERN_WARNING
@@ -698,6 +718,7 @@ start_journal_io:
 	}
 
 	blk_finish_plug(&plug);
+	phases.ps_data_wait = jbd2_phase_us(&phase_start);
 
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
@@ -799,6 +820,7 @@ wait_for_iobuf:
 	if (err)
 		jbd2_journal_abort(journal, err);
 
+	phases.ps_log_wait = jbd2_phase_us(&phase_start);
 	jbd_debug(3, "JBD: commit phase 5\n");
 
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
@@ -819,6 +841,8 @@ wait_for_iobuf:
 	if (err)
 		jbd2_journal_abort(journal, err);
 
+	phases.ps_commit = jbd2_phase_us(&phase_start);
+
 	/* End of a transaction!  Finally, we can do checkpoint
            processing: any buffers committed as a result of this
            transaction can be removed from any checkpoint list it was on
@@ -969,6 +993,9 @@ restart_loop:
 		atomic_read(&commit_transaction->t_handle_count);
 	trace_jbd2_run_stats(journal->j_fs_dev->bd_dev,
 			     commit_transaction->t_tid, &stats.run);
+	phases.ps_forget = jbd2_phase_us(&phase_start);
+	trace_jbd2_commit_phases(journal->j_fs_dev->bd_dev,
+				 commit_transaction->t_tid, &phases);
 
 	/*
 	 * Calculate overall stats
@@ -1035,3 +1062,161 @@ restart_loop:
 
 	wake_up(&journal->j_wait_done_commit);
 }
+
+__u32 jbd2_fc_checksum(struct jbd2_fc_header *header)
+{
+	__u32 crc32_sum;
+
+	crc32_sum = crc32_be(~0, (void *)header,
+			     offsetof(struct jbd2_fc_header, h_chksum));
+	return crc32_be(crc32_sum, (void *)(header + 1),
+			be32_to_cpu(header->h_len));
+}
+
+/**
+ * int jbd2_journal_fast_commit() - log a record for the running transaction
+ * @handle: handle on the running transaction, with a credit to spare
+ * @data: the record
+ * @len: its length, at most a journal block less a struct jbd2_fc_header
+ *
+ * Writes @data into the log on its own and waits for it to be on stable
+ * storage, without committing the transaction.  Should the transaction
+ * never commit, the journal's j_fc_replay is handed the record during
+ * recovery, after the transactions which did.  This takes one block and
+ * a cache flush instead of a whole commit, for a caller which can make
+ * its change durable with a small record.
+ *
+ * Returns -EAGAIN if the transaction has started committing, the
+ * previous one has not finished or the log is running out of space: the
+ * caller should wait for the commit instead.  The first fast commit in the log sets the fast commit
+ * feature in the journal superblock.
+ */
+int jbd2_journal_fast_commit(handle_t *handle, const void *data, int len)
+{
+	transaction_t *transaction = handle->h_transaction;
+	journal_t *journal = transaction->t_journal;
+	struct jbd2_fc_header *header;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	ktime_t start = ktime_get();
+	u32 duration;
+	int sb_update;
+	int ret;
+
+	if (len > journal->j_blocksize - sizeof(*header))
+		return -EINVAL;
+	if (is_handle_aborted(handle))
+		return -EROFS;
+	if (handle->h_buffer_credits < 1)
+		return -ENOSPC;
+	if (!jbd2_journal_check_available_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&journal->j_fc_mutex);
+
+	write_lock(&journal->j_state_lock);
+	if (transaction->t_state != T_RUNNING ||
+	    journal->j_committing_transaction) {
+		write_unlock(&journal->j_state_lock);
+		ret = -EAGAIN;
+		goto out;
+	}
+	/*
+	 * The record keeps its block until the transaction commits, and
+	 * new handles must still find room in the log: once it runs
+	 * short, have the transaction committed instead.
+	 */
+	if (__jbd2_log_space_left(journal) < jbd_space_needed(journal) + 1) {
+		__jbd2_log_start_commit(journal, transaction->t_tid);
+		write_unlock(&journal->j_state_lock);
+		ret = -EAGAIN;
+		goto out;
+	}
+	/*
+	 * Nothing else writes to the log until this handle is stopped, so
+	 * the block we get is the head of the log.  Recovery has to start
+	 * from the first fast commit if the transaction does not commit.
+	 */
+	if (!transaction->t_log_start)
+		transaction->t_log_start = journal->j_head;
+	/*
+	 * Tools which can't read the record must not find it in the log:
+	 * the feature has to be on disk before the first one is written.
+	 * jbd2_cleanup_journal_tail() clears it again, under j_state_lock.
+	 */
+	journal->j_fc_tid = transaction->t_tid;
+	sb_update = (journal->j_flags & JBD2_FLUSHED) ||
+		    !JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	jbd2_journal_set_features(journal, 0, 0,
+				  JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	write_unlock(&journal->j_state_lock);
+
+	/* This also erases the effects of a prior jbd2_journal_flush */
+	if (sb_update)
+		jbd2_journal_update_superblock(journal, 1);
+
+	/* The block is paid for by the handle, like commit does it */
+	ret = jbd2_journal_next_log_block(journal, &blocknr);
+	if (ret)
+		goto abort;
+	handle->h_buffer_credits--;
+	atomic_dec(&transaction->t_outstanding_credits);
+
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh) {
+		ret = -ENOMEM;
+		goto abort;
+	}
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, bh->b_size);
+	header = (struct jbd2_fc_header *)bh->b_data;
+	header->h_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	header->h_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	header->h_header.h_sequence = cpu_to_be32(transaction->t_tid);
+	header->h_len = cpu_to_be32(len);
+	memcpy(header + 1, data, len);
+	header->h_chksum = cpu_to_be32(jbd2_fc_checksum(header));
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = journal_end_buffer_io_sync;
+
+	/*
+	 * The file data the record refers to has been written by now: the
+	 * flush makes it stable along with the record.
+	 */
+	if ((journal->j_fs_dev != journal->j_dev) &&
+	    (journal->j_flags & JBD2_BARRIER))
+		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL);
+	if (journal->j_flags & JBD2_BARRIER)
+		submit_bh(WRITE_SYNC | WRITE_FLUSH_FUA, bh);
+	else
+		submit_bh(WRITE_SYNC, bh);
+	wait_on_buffer(bh);
+	if (unlikely(!buffer_uptodate(bh)))
+		ret = -EIO;
+	brelse(bh);
+	if (ret)
+		goto abort;
+
+	duration = ktime_to_us(ktime_sub(ktime_get(), start));
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_fast_commits++;
+	journal->j_stats.ts_fast_commit_us += duration;
+	spin_unlock(&journal->j_history_lock);
+	goto out;
+
+abort:
+	/*
+	 * The transaction's blocks would follow a block recovery can't
+	 * read past: it must not commit.
+	 */
+	jbd2_journal_abort(journal, ret);
+out:
+	mutex_unlock(&journal->j_fc_mutex);
+	trace_jbd2_fast_commit(journal, transaction->t_tid, len,
+			       ktime_to_us(ktime_sub(ktime_get(), start)), ret);
+	return ret;
+}
@@ -90,6 +90,7 @@ EXPORT_SYMBOL(jbd2_journal_blocks_per_page);
 EXPORT_SYMBOL(jbd2_journal_invalidatepage);
 EXPORT_SYMBOL(jbd2_journal_try_to_free_buffers);
 EXPORT_SYMBOL(jbd2_journal_force_commit);
+EXPORT_SYMBOL(jbd2_journal_fast_commit);
 EXPORT_SYMBOL(jbd2_journal_file_inode);
 EXPORT_SYMBOL(jbd2_journal_init_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_release_jbd_inode);
@@ -718,6 +719,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "%lu transaction, each up to %u blocks\n",
 			s->stats->ts_tid,
 			s->journal->j_max_transaction_buffers);
+	if (s->stats->ts_fast_commits)
+		seq_printf(seq, "%lu fast commits, %lluus on average\n",
+			   s->stats->ts_fast_commits,
+			   div_u64(s->stats->ts_fast_commit_us,
+				   s->stats->ts_fast_commits));
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -844,6 +850,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_updates);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	mutex_init(&journal->j_fc_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1283,6 +1290,10 @@ int jbd2_journal_load(journal_t *journal)
 		return -EIO;
 	}
 
+	/* Any fast commits have been replayed, and the log is emptied. */
+	jbd2_journal_clear_features(journal, 0, 0,
+				    JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+
 	/* OK, we've finished with the dynamic journal bits:
 	 * reinitialise the dynamic contents of the superblock in memory
 	 * and reset them on disk. */
@@ -1336,7 +1347,13 @@ int jbd2_journal_destroy(journal_t *journal)
 
 	if (journal->j_sb_buffer) {
 		if (!is_journal_aborted(journal)) {
-			/* We can now mark the journal as empty. */
+			/*
+			 * We can now mark the journal as empty.  There are
+			 * no fast commits in it any more, so other tools
+			 * need not know about them.
+			 */
+			jbd2_journal_clear_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
 			journal->j_tail = 0;
 			journal->j_tail_sequence =
 				++journal->j_transaction_sequence;
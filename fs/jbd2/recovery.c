@@ -35,6 +35,12 @@ struct recovery_info
 	int		nr_replays;
 	int		nr_revokes;
 	int		nr_revoke_hits;
+
+	/* Fast commits of the transaction after the last committed one */
+	tid_t		fc_transaction;
+	unsigned long	fc_block;
+	int		nr_fc;
+	int		nr_fc_replays;
 };
 
 enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
@@ -42,6 +48,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int replay_fast_commits(journal_t *, struct recovery_info *);
 
 #ifdef __KERNEL__
 
@@ -250,12 +257,15 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err)
+		err = replay_fast_commits(journal, &info);
 
 	jbd_debug(1, "JBD: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
 		  err, info.start_transaction, info.end_transaction);
 	jbd_debug(1, "JBD: Replayed %d and revoked %d/%d blocks\n",
 		  info.nr_replays, info.nr_revoke_hits, info.nr_revokes);
+	jbd_debug(1, "JBD: Replayed %d fast commits\n", info.nr_fc_replays);
 
 	/* Restart the log at the next transaction ID, thus invalidating
 	 * any existing commit records in the log. */
@@ -393,6 +403,7 @@ static int do_one_pass(journal_t *journal,
 		journal_block_tag_t *	tag;
 		struct buffer_head *	obh;
 		struct buffer_head *	nbh;
+		unsigned long		this_block;
 
 		cond_resched();
 
@@ -416,6 +427,7 @@ static int do_one_pass(journal_t *journal,
 		if (err)
 			goto failed;
 
+		this_block = next_log_block;
 		next_log_block++;
 		wrap(journal, next_log_block);
 
@@ -648,6 +660,9 @@ static int do_one_pass(journal_t *journal,
 				crc32_sum = ~0;
 			}
 			brelse(bh);
+			/* The commit superseded its fast commits */
+			if (pass == PASS_SCAN)
+				info->nr_fc = 0;
 			next_commit_ID++;
 			continue;
 
@@ -666,6 +681,34 @@ static int do_one_pass(journal_t *journal,
 				goto failed;
 			continue;
 
+		case JBD2_FC_BLOCK:
+			/* Fast commits are all at the start of their
+			 * transaction, and only replayed, once the other
+			 * passes are done, if it did not commit.  One which
+			 * didn't make it to the disk ends the log. */
+			if (pass == PASS_SCAN) {
+				struct jbd2_fc_header *fc =
+					(struct jbd2_fc_header *)bh->b_data;
+				__u32 len = be32_to_cpu(fc->h_len);
+
+				if (len > journal->j_blocksize - sizeof(*fc) ||
+				    be32_to_cpu(fc->h_chksum) !=
+							jbd2_fc_checksum(fc)) {
+					jbd_debug(3, "Bad fast commit block "
+						  "%lu, end of scan.\n",
+						  this_block);
+					brelse(bh);
+					goto done;
+				}
+				if (!info->nr_fc) {
+					info->fc_transaction = next_commit_ID;
+					info->fc_block = this_block;
+				}
+				info->nr_fc++;
+			}
+			brelse(bh);
+			continue;
+
 		default:
 			jbd_debug(3, "Unrecognised magic %d, end of scan.\n",
 				  blocktype);
@@ -704,6 +747,44 @@ static int do_one_pass(journal_t *journal,
 }
 
 
+/*
+ * Hand the fast commit records of the transaction which did not commit to
+ * the file system, after the committed transactions have been replayed.
+ */
+static int replay_fast_commits(journal_t *journal, struct recovery_info *info)
+{
+	unsigned long next_log_block = info->fc_block;
+	struct jbd2_fc_header *fc;
+	struct buffer_head *bh;
+	int i, err;
+
+	if (!info->nr_fc || info->fc_transaction != info->end_transaction)
+		return 0;
+
+	if (!journal->j_fc_replay) {
+		printk(KERN_WARNING "JBD: no one to replay %d fast commits\n",
+		       info->nr_fc);
+		return 0;
+	}
+
+	for (i = 0; i < info->nr_fc; i++) {
+		err = jread(&bh, journal, next_log_block);
+		if (err)
+			return err;
+		next_log_block++;
+		wrap(journal, next_log_block);
+
+		fc = (struct jbd2_fc_header *)bh->b_data;
+		err = journal->j_fc_replay(journal, fc + 1,
+					   be32_to_cpu(fc->h_len));
+		brelse(bh);
+		if (err)
+			return err;
+		++info->nr_fc_replays;
+	}
+	return 0;
+}
+
 /* Scan a revoke record, marking all blocks mentioned as revoked. */
 
 static int scan_revoke_records(journal_t *journal, struct buffer_head *bh,
@@ -36,7 +36,7 @@ enum android_alarm_type {
 #ifdef __KERNEL__
 
 #include <linux/ktime.h>
-#include <linux/rbtree.h>
+#include <linux/timerqueue.h>
 
 /*
  * The alarm interface is similar to the hrtimer interface but adds support
@@ -47,10 +47,9 @@ enum android_alarm_type {
 
 /**
  * struct alarm - the basic alarm structure
- * @node:	red black tree node for time ordered insertion
+ * @node:	timerqueue node, holding the absolute expiry time
  * @type:	alarm type. rtc/elapsed-realtime/systemtime, wakeup/non-wakeup.
  * @softexpires: the absolute earliest expiry time of the alarm.
- * @expires:	the absolute expiry time.
  * @function:	alarm expiry callback function
  *
  * The alarm structure must be initialized by alarm_init()
@@ -58,10 +57,9 @@ enum android_alarm_type {
  */
 
 struct alarm {
-	struct rb_node 		node;
+	struct timerqueue_node	node;
 	enum android_alarm_type type;
 	ktime_t			softexpires;
-	ktime_t			expires;
 	void			(*function)(struct alarm *);
 };
 
@@ -346,6 +346,14 @@ struct request_queue
 	unsigned int		nr_sorted;
 	unsigned int		in_flight[2];
 
+	/*
+	 * plugging statistics: plugged lists flushed into this queue, how
+	 * many of them from schedule(), and the requests they carried
+	 */
+	unsigned long		nr_unplugs;
+	unsigned long		nr_unplugs_sched;
+	unsigned long		nr_unplugged_rqs;
+
 	unsigned int		rq_timeout;
 	struct timer_list	timeout;
 	struct list_head	timeout_list;
@@ -11,8 +11,19 @@
 /* The full zone was compacted */
 #define COMPACT_COMPLETE	3
 
+/* Events recorded in the per-order compaction statistics */
+enum compact_event {
+	COMPACT_EV_STALL,
+	COMPACT_EV_SUCCESS,
+	COMPACT_EV_FAIL,
+	COMPACT_EV_DEFERRED,
+	COMPACT_EV_BACKGROUND,
+	COMPACT_EV_BACKGROUND_SUCCESS,
+};
+
 #ifdef CONFIG_COMPACTION
 extern int sysctl_compact_memory;
+extern int sysctl_compact_background;
 extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 extern int sysctl_extfrag_threshold;
@@ -26,6 +37,14 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 extern unsigned long compact_zone_order(struct zone *zone, int order,
 					gfp_t gfp_mask, bool sync);
+extern unsigned long compact_zone_range(struct zone *zone,
+			unsigned long start_pfn, unsigned long end_pfn,
+			bool sync);
+extern void compaction_account(int order, enum compact_event event);
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order,
+			enum zone_type classzone_idx);
+extern int kcompactd_run(int nid);
+extern void kcompactd_stop(int nid);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -75,6 +94,31 @@ static inline unsigned long compact_zone_order(struct zone *zone, int order,
 	return COMPACT_CONTINUE;
 }
 
+static inline unsigned long compact_zone_range(struct zone *zone,
+			unsigned long start_pfn, unsigned long end_pfn,
+			bool sync)
+{
+	return COMPACT_SKIPPED;
+}
+
+static inline void compaction_account(int order, enum compact_event event)
+{
+}
+
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order,
+				    enum zone_type classzone_idx)
+{
+}
+
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop(int nid)
+{
+}
+
 static inline void defer_compaction(struct zone *zone)
 {
 }
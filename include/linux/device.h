@@ -521,6 +521,23 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+/*
+ * Resume the device in the background once the devices registered before
+ * it have been resumed, without making the devices after it wait for it.
+ * Only for drivers which nothing but their children depend on.
+ */
+static inline void device_enable_async_resume(struct device *dev)
+{
+	if (!dev->power.is_prepared)
+		dev->power.async_resume = true;
+}
+
+static inline void device_disable_async_resume(struct device *dev)
+{
+	if (!dev->power.is_prepared)
+		dev->power.async_resume = false;
+}
+
 static inline void device_lock(struct device *dev)
 {
 	mutex_lock(&dev->mutex);
@@ -18,6 +18,7 @@
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/list.h>
+#include <linux/completion.h>
 #endif
 
 /* The early_suspend structure defines suspend and resume hooks to be called
@@ -29,18 +30,41 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ *
+ * Handlers which set async run concurrently with the async handlers next to
+ * them in level order; a handler without async waits for all the async
+ * handlers before it and runs alone. Among such a run of async handlers, a
+ * handler which needs another one to be working while it runs lists it in
+ * depends_on: it is suspended before and resumed after the handlers it
+ * depends on. Dependencies outside the run are already ordered by level.
+ * A handler whose dependencies would form a cycle is registered without
+ * them.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
 	EARLY_SUSPEND_LEVEL_STOP_DRAWING = 100,
 	EARLY_SUSPEND_LEVEL_DISABLE_FB = 150,
 };
+#define EARLY_SUSPEND_MAX_DEPS 2
 struct early_suspend {
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct list_head link;
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	bool async;
+	struct early_suspend *depends_on[EARLY_SUSPEND_MAX_DEPS];
+
+	/* owned by the early suspend core */
+	struct completion done;
+	int run;
+	bool queued;
+	unsigned int suspend_count;
+	unsigned int resume_count;
+	u32 last_suspend_us;
+	u32 max_suspend_us;
+	u32 last_resume_us;
+	u32 max_resume_us;
 #endif
 };
 
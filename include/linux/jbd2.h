@@ -130,6 +130,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -192,6 +193,18 @@ typedef struct jbd2_journal_revoke_header_s
 	__be32		 r_count;	/* Count of bytes used in the block */
 } jbd2_journal_revoke_header_t;
 
+/*
+ * The fast commit block: a record logged for the running transaction by
+ * jbd2_journal_fast_commit(), only replayed if that transaction did not
+ * commit.  The checksum covers the header up to h_chksum and the record.
+ */
+struct jbd2_fc_header
+{
+	journal_header_t h_header;
+	__be32		 h_len;		/* Bytes of record after the header */
+	__be32		 h_chksum;	/* crc32_be of header and record */
+};
+
 
 /* Definitions for the journal tag flags word: */
 #define JBD2_FLAG_ESCAPE		1	/* on-disk block is escaped */
@@ -263,13 +276,15 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000040
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -536,7 +551,8 @@ struct transaction_s
 	}			t_state;
 
 	/*
-	 * Where in the log does this transaction's commit start? [no locking]
+	 * Where in the log does this transaction start?  Set by its first
+	 * fast commit, or else when it starts to commit. [j_state_lock]
 	 */
 	unsigned long		t_log_start;
 
@@ -681,9 +697,22 @@ struct transaction_run_stats_s {
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fast_commits;
+	u64			ts_fast_commit_us;
 	struct transaction_run_stats_s run;
 };
 
+/* Time spent in each phase of a commit, in microseconds */
+struct transaction_phase_stats_s {
+	u32			ps_locked;	/* waiting for handles */
+	u32			ps_data;	/* submitting ordered data */
+	u32			ps_log;		/* submitting metadata */
+	u32			ps_data_wait;	/* waiting for ordered data */
+	u32			ps_log_wait;	/* waiting for the log */
+	u32			ps_commit;	/* writing the commit block */
+	u32			ps_forget;	/* filing checkpoint buffers */
+};
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -762,6 +791,10 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_fc_mutex: Serialises fast commits
+ * @j_fc_tid: Transaction of the last fast commit
+ * @j_fc_replay: Called at recovery for each fast commit record of a
+ *  transaction which did not commit
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -994,6 +1027,23 @@ struct journal_s
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
+	/*
+	 * Fast commits are written one at a time, so that a record which
+	 * did not make it to the disk is always the end of the log.
+	 */
+	struct mutex		j_fc_mutex;
+
+	/*
+	 * Transaction of the last fast commit.  The fast commit feature is
+	 * set in the superblock while the log may hold fast commits, and
+	 * cleared once its tail has moved past this transaction.
+	 * [j_state_lock]
+	 */
+	tid_t			j_fc_tid;
+
+	/* This function is called to replay a fast commit record */
+	int			(*j_fc_replay)(journal_t *, const void *, int);
+
 	/*
 	 * An opaque pointer to fs-private information.  ext3 puts its
 	 * superblock pointer here
@@ -1035,6 +1085,7 @@ int jbd2_journal_next_log_block(journal_t *, unsigned long long *);
 
 /* Commit management */
 extern void jbd2_journal_commit_transaction(journal_t *);
+extern __u32 jbd2_fc_checksum(struct jbd2_fc_header *);
 
 /* Checkpoint list management */
 int __jbd2_journal_clean_checkpoint_list(journal_t *journal);
@@ -1151,6 +1202,7 @@ extern void	   jbd2_journal_ack_err    (journal_t *);
 extern int	   jbd2_journal_clear_err  (journal_t *);
 extern int	   jbd2_journal_bmap(journal_t *, unsigned long, unsigned long long *);
 extern int	   jbd2_journal_force_commit(journal_t *);
+extern int	   jbd2_journal_fast_commit(handle_t *, const void *, int);
 extern int	   jbd2_journal_file_inode(handle_t *handle, struct jbd2_inode *inode);
 extern int	   jbd2_journal_begin_ordered_truncate(journal_t *journal,
 				struct jbd2_inode *inode, loff_t new_size);
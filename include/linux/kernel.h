@@ -376,6 +376,18 @@ static inline void tracing_off_permanent(void) { }
 static inline int tracing_is_on(void) { return 0; }
 #endif
 
+/*
+ * tracing_snapshot() freezes the trace recorded so far into the snapshot
+ * buffer, without stopping tracing, if the snapshot has been armed by
+ * writing 2 to /sys/kernel/debug/tracing/snapshot. Use it to catch what
+ * led up to a rare condition on a production system.
+ */
+#ifdef CONFIG_TRACER_SNAPSHOT
+void tracing_snapshot(void);
+#else
+static inline void tracing_snapshot(void) { }
+#endif
+
 enum ftrace_dump_mode {
 	DUMP_NONE,
 	DUMP_ALL,
@@ -64,6 +64,10 @@ struct mmc_ext_csd {
 	u8			out_of_int_time;	/* out of int time */
 	bool			bk_ops;			/* BK ops support bit */
 	bool			bk_ops_en;		/* BK ops enable bit */
+	u8			max_packed_writes;	/* 0: no packed cmds */
+	bool			packed_event_en;	/* packed failure events */
+	unsigned int		cache_size;		/* Units: KB */
+	bool			cache_ctrl;		/* cache enable bit */
 };
 
 struct sd_scr {
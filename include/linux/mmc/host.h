@@ -106,6 +106,18 @@ struct mmc_host_ops {
 	 */
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
+	/*
+	 * It is optional for the host to implement pre_req and post_req in
+	 * order to support double buffering of requests (prepare one
+	 * request while another request is active).
+	 * pre_req() must always be followed by a post_req().
+	 * To undo a call made to pre_req(), call post_req() with
+	 * a nonzero err condition.
+	 */
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req,
+			   bool is_first_req);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
 	/*
 	 * Avoid calling these three functions too often or in a "fast path",
@@ -145,6 +157,16 @@ struct mmc_host_ops {
 struct mmc_card;
 struct device;
 
+struct mmc_async_req {
+	/* active mmc request */
+	struct mmc_request	*mrq;
+	/*
+	 * Check error status of completed mmc request.
+	 * Returns 0 if success otherwise non zero.
+	 */
+	int (*err_check) (struct mmc_card *, struct mmc_async_req *);
+};
+
 struct mmc_host {
 	struct device		*parent;
 	struct device		class_dev;
@@ -208,6 +230,8 @@ struct mmc_host {
 #define MMC_CAP_DRIVER_TYPE_C	(1 << 24)	/* Host supports Driver Type C */
 #define MMC_CAP_DRIVER_TYPE_D	(1 << 25)	/* Host supports Driver Type D */
 #define MMC_CAP_BKOPS		(1 << 26)	/* Host supports BKOPS */
+#define MMC_CAP_PACKED_WR	(1 << 27)	/* Host can send packed writes */
+#define MMC_CAP_CACHE_CTRL	(1 << 28)	/* Allow eMMC volatile cache */
 
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
@@ -282,6 +306,12 @@ struct mmc_host {
 
 	struct dentry		*debugfs_root;
 
+	atomic64_t		bounce_bytes;	/* data copied by the CPU */
+	u64			bounce_last;	/* bounce_bytes at last read */
+	unsigned long		bounce_stamp;	/* jiffies at last read */
+
+	struct mmc_async_req	*areq;		/* active async req */
+
 #ifdef CONFIG_MMC_EMBEDDED_SDIO
 	struct {
 		struct sdio_cis			*cis;
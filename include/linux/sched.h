@@ -142,6 +142,17 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+/*
+ * Decayed per-cpu and per-task load, for cpufreq governors and cpu
+ * hotplug policies. Utilization is in units of SCHED_LOAD_SCALE.
+ */
+struct task_struct;
+extern unsigned long sched_cpu_load_avg(int cpu);
+extern unsigned long sched_cpu_util(int cpu);
+extern unsigned long sched_task_load_avg(struct task_struct *p);
+
+extern unsigned long task_timer_slack_ns(struct task_struct *p);
+
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -1139,6 +1150,19 @@ struct sched_statistics {
 };
 #endif
 
+#ifdef CONFIG_SMP
+/*
+ * Decayed runnable average: the time an entity was runnable, accumulated
+ * in 1024us periods, where each period contributes y^n with y^32 = 1/2.
+ */
+struct sched_avg {
+	u32			runnable_avg_sum;
+	u32			runnable_avg_period;
+	u64			last_runnable_update;
+	unsigned long		load_avg_contrib;
+};
+#endif
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1152,6 +1176,10 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SMP
+	struct sched_avg	avg;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -6,6 +6,7 @@
 #include <linux/init.h>
 #include <linux/pm.h>
 #include <linux/mm.h>
+#include <linux/ktime.h>
 #include <asm/errno.h>
 
 #if defined(CONFIG_PM_SLEEP) && defined(CONFIG_VT) && defined(CONFIG_VT_CONSOLE)
@@ -297,6 +298,22 @@ static inline int unregister_pm_notifier(struct notifier_block *nb)
 static inline bool pm_wakeup_pending(void) { return false; }
 #endif /* !CONFIG_PM_SLEEP */
 
+#ifdef CONFIG_PM_SLEEP_TIMELINE
+extern void pm_timeline_begin(void);
+extern void pm_timeline_end(void);
+extern void pm_timeline_add(const char *phase, const char *name,
+			    ktime_t start, int error);
+extern void pm_timeline_add_span(const char *phase, const char *name,
+				 u32 duration_us);
+#else
+static inline void pm_timeline_begin(void) {}
+static inline void pm_timeline_end(void) {}
+static inline void pm_timeline_add(const char *phase, const char *name,
+				   ktime_t start, int error) {}
+static inline void pm_timeline_add_span(const char *phase, const char *name,
+					u32 duration_us) {}
+#endif
+
 extern struct mutex pm_mutex;
 
 #ifndef CONFIG_HIBERNATE_CALLBACKS
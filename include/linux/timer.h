@@ -237,6 +237,7 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_COALESCED	0x2
 
 extern void init_timer_stats(void);
 
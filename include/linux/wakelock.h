@@ -35,6 +35,7 @@ enum {
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
+	struct list_head    active_link;
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
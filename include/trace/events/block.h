@@ -162,6 +162,22 @@ DEFINE_EVENT(block_rq, block_rq_issue,
 	TP_ARGS(q, rq)
 );
 
+/**
+ * block_rq_hw_start - device driver started the transfer of a request
+ * @q: queue holding operation
+ * @rq: block IO operation operation request
+ *
+ * Called by drivers which prepare requests ahead of time when the
+ * hardware actually starts on @rq (e.g. its DMA is started), which can
+ * be well after block_rq_issue.
+ */
+DEFINE_EVENT(block_rq, block_rq_hw_start,
+
+	TP_PROTO(struct request_queue *q, struct request *rq),
+
+	TP_ARGS(q, rq)
+);
+
 /**
  * block_bio_bounce - used bounce buffer when processing block operation
  * @q: queue holding the block operation
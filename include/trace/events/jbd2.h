@@ -9,6 +9,7 @@
 
 struct transaction_chp_stats_s;
 struct transaction_run_stats_s;
+struct transaction_phase_stats_s;
 
 TRACE_EVENT(jbd2_checkpoint,
 
@@ -168,6 +169,71 @@ TRACE_EVENT(jbd2_run_stats,
 		  __entry->blocks_logged)
 );
 
+TRACE_EVENT(jbd2_commit_phases,
+	TP_PROTO(dev_t dev, unsigned long tid,
+		 struct transaction_phase_stats_s *stats),
+
+	TP_ARGS(dev, tid, stats),
+
+	TP_STRUCT__entry(
+		__field(		dev_t,	dev		)
+		__field(	unsigned long,	tid		)
+		__field(		__u32,	locked		)
+		__field(		__u32,	data		)
+		__field(		__u32,	log		)
+		__field(		__u32,	data_wait	)
+		__field(		__u32,	log_wait	)
+		__field(		__u32,	commit		)
+		__field(		__u32,	forget		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= dev;
+		__entry->tid		= tid;
+		__entry->locked		= stats->ps_locked;
+		__entry->data		= stats->ps_data;
+		__entry->log		= stats->ps_log;
+		__entry->data_wait	= stats->ps_data_wait;
+		__entry->log_wait	= stats->ps_log_wait;
+		__entry->commit		= stats->ps_commit;
+		__entry->forget		= stats->ps_forget;
+	),
+
+	TP_printk("dev %s tid %lu locked %uus data %uus log %uus "
+		  "data_wait %uus log_wait %uus commit %uus forget %uus",
+		  jbd2_dev_to_name(__entry->dev), __entry->tid,
+		  __entry->locked, __entry->data, __entry->log,
+		  __entry->data_wait, __entry->log_wait, __entry->commit,
+		  __entry->forget)
+);
+
+TRACE_EVENT(jbd2_fast_commit,
+	TP_PROTO(journal_t *journal, tid_t tid, int len, u32 duration_us,
+		 int ret),
+
+	TP_ARGS(journal, tid, len, duration_us, ret),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,	dev			)
+		__field(	tid_t,	tid			)
+		__field(	int,	len			)
+		__field(	__u32,	duration_us		)
+		__field(	int,	ret			)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= journal->j_fs_dev->bd_dev;
+		__entry->tid		= tid;
+		__entry->len		= len;
+		__entry->duration_us	= duration_us;
+		__entry->ret		= ret;
+	),
+
+	TP_printk("dev %s tid %u len %d duration %uus ret %d",
+		  jbd2_dev_to_name(__entry->dev), __entry->tid, __entry->len,
+		  __entry->duration_us, __entry->ret)
+);
+
 TRACE_EVENT(jbd2_checkpoint_stats,
 	TP_PROTO(dev_t dev, unsigned long tid,
 		 struct transaction_chp_stats_s *stats),
@@ -65,6 +65,67 @@ TRACE_EVENT(machine_suspend,
 	TP_printk("state=%lu", (unsigned long)__entry->state)
 );
 
+TRACE_EVENT(wake_lock,
+
+	TP_PROTO(const char *name, int type, long timeout),
+
+	TP_ARGS(name, type, timeout),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	int,		type		)
+		__field(	long,		timeout		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->type = type;
+		__entry->timeout = timeout;
+	),
+
+	TP_printk("name=%s type=%d timeout=%ld", __get_str(name),
+		  __entry->type, __entry->timeout)
+);
+
+TRACE_EVENT(wake_unlock,
+
+	TP_PROTO(const char *name, int type, int expired),
+
+	TP_ARGS(name, type, expired),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	int,		type		)
+		__field(	int,		expired		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->type = type;
+		__entry->expired = expired;
+	),
+
+	TP_printk("name=%s type=%d expired=%d", __get_str(name),
+		  __entry->type, __entry->expired)
+);
+
+TRACE_EVENT(suspend_blocked,
+
+	TP_PROTO(const char *name),
+
+	TP_ARGS(name),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+	),
+
+	TP_printk("name=%s", __get_str(name))
+);
+
 /* This code will be removed after deprecation time exceeded (2.6.41) */
 #ifdef CONFIG_EVENT_POWER_TRACING_DEPRECATED
 
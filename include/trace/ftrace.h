@@ -531,9 +531,12 @@ ftrace_raw_event_##call(void *__data, proto)				\
 									\
 	{ assign; }							\
 									\
-	if (!filter_current_check_discard(buffer, event_call, entry, event)) \
+	if (!filter_current_check_discard(buffer, event_call, entry, event)) { \
 		trace_nowake_buffer_unlock_commit(buffer,		\
 						  event, irq_flags, pc); \
+		if (unlikely(event_call->flags & TRACE_EVENT_FL_SNAPSHOT)) \
+			tracing_snapshot();				\
+	}								\
 }
 /*
  * The ftrace_test_probe is compiled out, it is only here as a build time check
@@ -782,13 +782,25 @@ static inline void timer_stats_hrtimer_clear_start_info(struct hrtimer *timer)
 #endif
 }
 
-static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
+static inline void timer_stats_account_hrtimer(struct hrtimer *timer,
+					       ktime_t *now)
 {
 #ifdef CONFIG_TIMER_STATS
+	unsigned int flag = 0;
+
 	if (likely(!timer_stats_active))
 		return;
+	/*
+	 * Ran inside its slack window, on a wakeup that was due anyway.
+	 * Only hrtimer_interrupt() runs timers before their hard expiry,
+	 * the tick driven low resolution path never does.
+	 */
+	if (hrtimer_hres_active() &&
+	    now->tv64 >= hrtimer_get_softexpires_tv64(timer) &&
+	    now->tv64 < hrtimer_get_expires_tv64(timer))
+		flag |= TIMER_STATS_FLAG_COALESCED;
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm, flag);
 #endif
 }
 
@@ -1196,7 +1208,7 @@ static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
 
 	debug_deactivate(timer);
 	__remove_hrtimer(timer, base, HRTIMER_STATE_CALLBACK, 0);
-	timer_stats_account_hrtimer(timer);
+	timer_stats_account_hrtimer(timer, now);
 	fn = timer->function;
 
 	/*
@@ -1554,7 +1566,7 @@ long hrtimer_nanosleep(struct timespec *rqtp, struct timespec __user *rmtp,
 	int ret = 0;
 	unsigned long slack;
 
-	slack = current->timer_slack_ns;
+	slack = task_timer_slack_ns(current);
 	if (rt_task(current))
 		slack = 0;
 
@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -29,6 +33,8 @@ enum {
 };
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int async_enabled = 1;
+module_param_named(async, async_enabled, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
@@ -44,11 +50,205 @@ enum {
 };
 static int state;
 
+static LIST_HEAD(early_suspend_domain);
+static bool pass_async;
+static u32 last_early_suspend_us;
+static u32 last_late_resume_us;
+
+static void call_handler(struct early_suspend *h, bool suspend)
+{
+	ktime_t start = ktime_get();
+	u32 us;
+
+	if (suspend ? !h->suspend : !h->resume)
+		goto done;
+
+	if (suspend)
+		h->suspend(h);
+	else
+		h->resume(h);
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	if (suspend) {
+		h->suspend_count++;
+		h->last_suspend_us = us;
+		h->max_suspend_us = max(h->max_suspend_us, us);
+	} else {
+		h->resume_count++;
+		h->last_resume_us = us;
+		h->max_resume_us = max(h->max_resume_us, us);
+	}
+done:
+	complete_all(&h->done);
+}
+
+static inline bool handler_async(struct early_suspend *h)
+{
+	return pass_async && h->async;
+}
+
+/*
+ * Numbers the runs of consecutive async handlers; sync handlers get 0.
+ * Done before any handler is started, so that the async ones can look at
+ * the rest of the list while the pass goes on.
+ */
+static void prepare_pass(void)
+{
+	struct early_suspend *pos;
+	bool in_run = false;
+	int run = 0;
+
+	pass_async = async_enabled;
+	list_for_each_entry(pos, &early_suspend_handlers, link) {
+		INIT_COMPLETION(pos->done);
+		pos->queued = false;
+		if (handler_async(pos)) {
+			if (!in_run)
+				run++;
+			in_run = true;
+			pos->run = run;
+		} else {
+			in_run = false;
+			pos->run = 0;
+		}
+	}
+}
+
+static inline bool same_run(struct early_suspend *a, struct early_suspend *b)
+{
+	return a->run && a->run == b->run;
+}
+
+static void early_suspend_async(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data, *pos;
+	int i;
+
+	/* the handlers which depend on h go down first */
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		for (i = 0; i < EARLY_SUSPEND_MAX_DEPS; i++)
+			if (pos->depends_on[i] == h && same_run(pos, h))
+				wait_for_completion(&pos->done);
+
+	call_handler(h, true);
+}
+
+static void late_resume_async(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data, *dep;
+	int i;
+
+	for (i = 0; i < EARLY_SUSPEND_MAX_DEPS; i++) {
+		dep = h->depends_on[i];
+		if (dep && same_run(dep, h))
+			wait_for_completion(&dep->done);
+	}
+
+	call_handler(h, false);
+}
+
+/*
+ * Returns true if h waits for a handler of its run which is not queued
+ * yet.  Queueing such handlers later keeps the pass from deadlocking when
+ * async_schedule_domain() falls back to calling the handler directly.
+ */
+static bool waits_for_unqueued(struct early_suspend *h, bool suspend)
+{
+	struct early_suspend *pos;
+	int i;
+
+	if (!suspend) {
+		for (i = 0; i < EARLY_SUSPEND_MAX_DEPS; i++) {
+			pos = h->depends_on[i];
+			if (pos && same_run(pos, h) && !pos->queued)
+				return true;
+		}
+		return false;
+	}
+
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		for (i = 0; i < EARLY_SUSPEND_MAX_DEPS; i++)
+			if (pos->depends_on[i] == h && same_run(pos, h) &&
+			    !pos->queued)
+				return true;
+	return false;
+}
+
+/*
+ * Queues the whole run of async handlers h belongs to, each one after
+ * those it waits for.  There are no dependency cycles, so every round
+ * queues at least one handler.
+ */
+static void queue_run(struct early_suspend *h, bool suspend)
+{
+	struct early_suspend *pos;
+	bool left;
+
+	do {
+		left = false;
+		list_for_each_entry(pos, &early_suspend_handlers, link) {
+			if (!same_run(pos, h) || pos->queued)
+				continue;
+			if (waits_for_unqueued(pos, suspend)) {
+				left = true;
+				continue;
+			}
+			pos->queued = true;
+			async_schedule_domain(suspend ? early_suspend_async :
+							late_resume_async,
+					      pos, &early_suspend_domain);
+		}
+	} while (left);
+}
+
+static bool handler_registered(struct early_suspend *h)
+{
+	struct early_suspend *pos;
+
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		if (pos == h)
+			return true;
+	return false;
+}
+
+/*
+ * Returns true if h depends on target, directly or through registered
+ * handlers.  Those have no cycles among them, so this terminates.
+ */
+static bool handler_depends_on(struct early_suspend *h,
+			       struct early_suspend *target)
+{
+	struct early_suspend *dep;
+	int i;
+
+	for (i = 0; i < EARLY_SUSPEND_MAX_DEPS; i++) {
+		dep = h->depends_on[i];
+		if (!dep)
+			continue;
+		if (dep == target)
+			return true;
+		if (handler_registered(dep) && handler_depends_on(dep, target))
+			return true;
+	}
+	return false;
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
 
+	init_completion(&handler->done);
+	handler->run = 0;
+	handler->queued = false;
+
 	mutex_lock(&early_suspend_lock);
+	/* a cycle would keep its handlers waiting for each other forever */
+	if (WARN(handler_depends_on(handler, handler),
+		 "early_suspend: dependency cycle through %pF, "
+		 "dependencies dropped\n",
+		 handler->suspend ? (void *)handler->suspend :
+				    (void *)handler->resume))
+		memset(handler->depends_on, 0, sizeof(handler->depends_on));
 	list_for_each(pos, &early_suspend_handlers) {
 		struct early_suspend *e;
 		e = list_entry(pos, struct early_suspend, link);
@@ -57,7 +257,7 @@ void register_early_suspend(struct early_suspend *handler)
 	}
 	list_add_tail(&handler->link, pos);
 	if ((state & SUSPENDED) && handler->suspend)
-		handler->suspend(handler);
+		call_handler(handler, true);
 	mutex_unlock(&early_suspend_lock);
 }
 EXPORT_SYMBOL(register_early_suspend);
@@ -74,6 +274,7 @@ static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -93,10 +294,19 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
+	prepare_pass();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL)
-			pos->suspend(pos);
+		if (handler_async(pos)) {
+			if (!pos->queued)
+				queue_run(pos, true);
+		} else {
+			async_synchronize_full_domain(&early_suspend_domain);
+			call_handler(pos, true);
+		}
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	last_early_suspend_us = ktime_to_us(ktime_sub(ktime_get(), start));
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -114,6 +324,7 @@ static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -131,9 +342,19 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-		if (pos->resume != NULL)
-			pos->resume(pos);
+	start = ktime_get();
+	prepare_pass();
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
+		if (handler_async(pos)) {
+			if (!pos->queued)
+				queue_run(pos, false);
+		} else {
+			async_synchronize_full_domain(&early_suspend_domain);
+			call_handler(pos, false);
+		}
+	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	last_late_resume_us = ktime_to_us(ktime_sub(ktime_get(), start));
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -176,3 +397,46 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "last early suspend %u us, late resume %u us\n\n",
+		   last_early_suspend_us, last_late_resume_us);
+	seq_printf(s, "level async suspends  last(us)   max(us)  resumes"
+		   "  last(us)   max(us) handler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d %5d %8u %9u %9u %8u %9u %9u %pF\n",
+			   pos->level, pos->async, pos->suspend_count,
+			   pos->last_suspend_us, pos->max_suspend_us,
+			   pos->resume_count, pos->last_resume_us,
+			   pos->max_resume_us,
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	debugfs_create_file("early_suspend_stats", 0444, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debug_init);
+#endif
@@ -136,6 +136,7 @@ void __attribute__ ((weak)) arch_suspend_enable_irqs(void)
  */
 static int suspend_enter(suspend_state_t state)
 {
+	ktime_t start;
 	int error;
 
 	if (suspend_ops->prepare) {
@@ -159,13 +160,17 @@ static int suspend_enter(suspend_state_t state)
 	if (suspend_test(TEST_PLATFORM))
 		goto Platform_wake;
 
+	start = ktime_get();
 	error = disable_nonboot_cpus();
+	pm_timeline_add("cpus_down", NULL, start, error);
 	if (error || suspend_test(TEST_CPUS))
 		goto Enable_cpus;
 
 	arch_suspend_disable_irqs();
 	BUG_ON(!irqs_disabled());
 
+	/* the time asleep is not part of the monotonic clock */
+	start = ktime_get();
 	error = sysdev_suspend(PMSG_SUSPEND);
 	if (!error) {
 		error = syscore_suspend();
@@ -180,12 +185,15 @@ static int suspend_enter(suspend_state_t state)
 		syscore_resume();
 		sysdev_resume();
 	}
+	pm_timeline_add("enter", NULL, start, error);
 
 	arch_suspend_enable_irqs();
 	BUG_ON(irqs_disabled());
 
  Enable_cpus:
+	start = ktime_get();
 	enable_nonboot_cpus();
+	pm_timeline_add("cpus_up", NULL, start, 0);
 
  Platform_wake:
 	if (suspend_ops->wake)
@@ -274,6 +282,7 @@ static void suspend_finish(void)
  */
 int enter_state(suspend_state_t state)
 {
+	ktime_t start;
 	int error;
 
 	if (!valid_state(state))
@@ -282,12 +291,18 @@ int enter_state(suspend_state_t state)
 	if (!mutex_trylock(&pm_mutex))
 		return -EBUSY;
 
+	pm_timeline_begin();
+
 	printk(KERN_INFO "PM: Syncing filesystems ... ");
+	start = ktime_get();
 	sys_sync();
+	pm_timeline_add("sync", NULL, start, 0);
 	printk("done.\n");
 
 	pr_debug("PM: Preparing system for %s sleep\n", pm_states[state]);
+	start = ktime_get();
 	error = suspend_prepare();
+	pm_timeline_add("freeze", NULL, start, error);
 	if (error)
 		goto Unlock;
 
@@ -301,8 +316,11 @@ int enter_state(suspend_state_t state)
 
  Finish:
 	pr_debug("PM: Finishing wakeup.\n");
+	start = ktime_get();
 	suspend_finish();
+	pm_timeline_add("thaw", NULL, start, 0);
  Unlock:
+	pm_timeline_end();
 	mutex_unlock(&pm_mutex);
 	return error;
 }
@@ -0,0 +1,208 @@
+/*
+ * kernel/power/timeline.c - per-phase, per-device suspend/resume timeline
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Every suspend attempt starts a new cycle.  The phases of the core
+ * suspend code, the callbacks of each device and the platform's own
+ * steps are recorded into a ring buffer with their start time (relative
+ * to the start of the cycle), duration, cpu and error code, and dumped
+ * from /sys/kernel/debug/suspend_timeline.  Device callbacks shorter than
+ * /sys/kernel/debug/suspend_timeline_min_us are not recorded.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
+#include <linux/vmalloc.h>
+
+#define TIMELINE_ENTRIES	512
+#define TIMELINE_NAME_LEN	24
+#define TIMELINE_NO_START	((u32)~0)
+
+struct timeline_entry {
+	unsigned int	cycle;
+	const char	*phase;
+	char		name[TIMELINE_NAME_LEN];
+	u32		start_us;
+	u32		duration_us;
+	int		error;
+	int		cpu;
+};
+
+static struct timeline_entry timeline[TIMELINE_ENTRIES];
+static unsigned int timeline_head;	/* next entry to write */
+static unsigned int timeline_count;
+static unsigned int timeline_cycle;
+static bool timeline_active;
+static ktime_t timeline_start;
+static u32 timeline_min_us = 100;
+static DEFINE_SPINLOCK(timeline_lock);
+
+/**
+ * pm_timeline_begin - start recording a new suspend/resume cycle
+ */
+void pm_timeline_begin(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&timeline_lock, flags);
+	timeline_cycle++;
+	timeline_start = ktime_get();
+	timeline_active = true;
+	spin_unlock_irqrestore(&timeline_lock, flags);
+}
+
+/**
+ * pm_timeline_end - stop recording the current cycle
+ */
+void pm_timeline_end(void)
+{
+	timeline_active = false;
+}
+
+static void timeline_record(const char *phase, const char *name,
+			    u32 start_us, u32 duration_us, int error)
+{
+	struct timeline_entry *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&timeline_lock, flags);
+	e = &timeline[timeline_head];
+	e->cycle = timeline_cycle;
+	e->phase = phase;
+	strlcpy(e->name, name ? name : "-", sizeof(e->name));
+	e->start_us = start_us;
+	e->duration_us = duration_us;
+	e->error = error;
+	e->cpu = raw_smp_processor_id();
+	timeline_head = (timeline_head + 1) % TIMELINE_ENTRIES;
+	if (timeline_count < TIMELINE_ENTRIES)
+		timeline_count++;
+	spin_unlock_irqrestore(&timeline_lock, flags);
+}
+
+/**
+ * pm_timeline_add - record a step which started at @start and ends now
+ * @phase: static string naming the phase
+ * @name: device name, or NULL for a step of the whole system
+ * @start: ktime_get() at the start of the step
+ * @error: result of the step
+ *
+ * Must not be called while timekeeping is suspended.
+ */
+void pm_timeline_add(const char *phase, const char *name, ktime_t start,
+		     int error)
+{
+	ktime_t now;
+	u32 duration_us;
+
+	if (!timeline_active)
+		return;
+
+	now = ktime_get();
+	duration_us = ktime_to_us(ktime_sub(now, start));
+	if (name && duration_us < timeline_min_us && !error)
+		return;
+
+	timeline_record(phase, name,
+			ktime_to_us(ktime_sub(start, timeline_start)),
+			duration_us, error);
+}
+
+/**
+ * pm_timeline_add_span - record a step timed by the caller
+ * @phase: static string naming the phase
+ * @name: device name, or NULL for a step of the whole system
+ * @duration_us: length of the step
+ *
+ * For platform code which runs while timekeeping is suspended and
+ * measures its steps with its own counters.  The start time is not known.
+ */
+void pm_timeline_add_span(const char *phase, const char *name,
+			  u32 duration_us)
+{
+	if (!timeline_active)
+		return;
+
+	timeline_record(phase, name, TIMELINE_NO_START, duration_us, 0);
+}
+
+static int timeline_show(struct seq_file *s, void *data)
+{
+	struct timeline_entry *buf;
+	unsigned int i, n, first;
+	unsigned long flags;
+
+	buf = vmalloc(sizeof(timeline));
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&timeline_lock, flags);
+	memcpy(buf, timeline, sizeof(timeline));
+	n = timeline_count;
+	first = (timeline_head + TIMELINE_ENTRIES - n) % TIMELINE_ENTRIES;
+	spin_unlock_irqrestore(&timeline_lock, flags);
+
+	seq_printf(s, "cycle cpu   start(us) length(us) error phase"
+		   "            device\n");
+	for (i = 0; i < n; i++) {
+		struct timeline_entry *e = &buf[(first + i) % TIMELINE_ENTRIES];
+
+		seq_printf(s, "%5u %3d ", e->cycle, e->cpu);
+		if (e->start_us == TIMELINE_NO_START)
+			seq_printf(s, "%11s ", "-");
+		else
+			seq_printf(s, "%11u ", e->start_us);
+		seq_printf(s, "%10u %5d %-16s %s\n", e->duration_us,
+			   e->error, e->phase, e->name);
+	}
+
+	vfree(buf);
+	return 0;
+}
+
+static int timeline_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, timeline_show, NULL);
+}
+
+static const struct file_operations timeline_fops = {
+	.open		= timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init timeline_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("suspend_timeline", 0444, NULL, NULL,
+				&timeline_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_timeline debug file\n");
+		return -ENOMEM;
+	}
+	debugfs_create_u32("suspend_timeline_min_us", 0644, NULL,
+			   &timeline_min_us);
+
+	return 0;
+}
+late_initcall(timeline_debug_init);
@@ -22,6 +22,7 @@
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
 #endif
+#include <trace/events/power.h>
 #include "power.h"
 
 enum {
@@ -40,9 +41,22 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
 #define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * Every initialized lock is on wake_locks. Active locks are also on
+ * timed_wake_locks or untimed_wake_locks of their type, so the expire timer
+ * only looks at the timed ones, the common "is anything holding off
+ * suspend" check is O(1), and the walks over active locks never see the
+ * inactive ones.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static LIST_HEAD(wake_locks);
+static struct list_head timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static struct list_head untimed_wake_locks[WAKE_LOCK_TYPE_COUNT];
+
+#define list_for_each_active_lock(lock, type, i)			\
+	for (i = 0; i < 2; i++)						\
+		list_for_each_entry(lock, i ? &timed_wake_locks[type] :	\
+				    &untimed_wake_locks[type], active_link)
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -119,18 +133,13 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	unsigned long irqflags;
 	struct wake_lock *lock;
 	int ret;
-	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
 			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
+	list_for_each_entry(lock, &wake_locks, link)
 		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
-	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
 }
@@ -152,7 +161,7 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
-	lock->stat.last_time = ktime_get();
+	lock->stat.last_time = expired ? ktime_get() : now;
 	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 		duration = ktime_sub(now, last_sleep_time_update);
 		lock->stat.prevent_suspend_time = ktime_add(
@@ -165,11 +174,11 @@ static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
 	ktime_t now, etime, elapsed, add;
-	int expired;
+	int expired, i;
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
+	list_for_each_active_lock(lock, WAKE_LOCK_SUSPEND, i) {
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 			if (expired)
@@ -189,14 +198,22 @@ static void update_sleep_wait_stats_locked(int done)
 #endif
 
 
+/* Caller must acquire the list_lock spinlock */
+static void deactivate_wake_lock(struct wake_lock *lock)
+{
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+	list_del_init(&lock->active_link);
+	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
+}
+
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	deactivate_wake_lock(lock);
+	trace_wake_unlock(lock->name, lock->flags & WAKE_LOCK_TYPE_MASK, 1);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
@@ -205,10 +222,13 @@ static void expire_wake_lock(struct wake_lock *lock)
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
-	bool print_expired = true;
+	bool print_expired;
+	int i;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	print_expired = list_empty(&untimed_wake_locks[type]) ||
+			(debug_mask & DEBUG_EXPIRE);
+	list_for_each_active_lock(lock, type, i) {
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout > 0)
@@ -218,27 +238,34 @@ static void print_active_locks(int type)
 				pr_info("wake lock %s, expired\n", lock->name);
 		} else {
 			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
 		}
 	}
 }
 
+/* Caller must acquire the list_lock spinlock */
+static void trace_suspend_blockers(void)
+{
+	struct wake_lock *lock;
+	int i;
+
+	list_for_each_active_lock(lock, WAKE_LOCK_SUSPEND, i)
+		trace_suspend_blocked(lock->name);
+}
+
 static long has_wake_lock_locked(int type)
 {
 	struct wake_lock *lock, *n;
 	long max_timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (!list_empty(&untimed_wake_locks[type]))
+		return -1;
+	list_for_each_entry_safe(lock, n, &timed_wake_locks[type], active_link) {
+		long timeout = lock->expires - jiffies;
+		if (timeout <= 0)
+			expire_wake_lock(lock);
+		else if (timeout > max_timeout)
+			max_timeout = timeout;
 	}
 	return max_timeout;
 }
@@ -255,12 +282,27 @@ long has_wake_lock(int type)
 	return ret;
 }
 
+static long has_suspend_blocker(void)
+{
+	long ret;
+	unsigned long irqflags;
+	spin_lock_irqsave(&list_lock, irqflags);
+	ret = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
+	if (ret) {
+		if (debug_mask & DEBUG_SUSPEND)
+			print_active_locks(WAKE_LOCK_SUSPEND);
+		trace_suspend_blockers();
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+	return ret;
+}
+
 static void suspend(struct work_struct *work)
 {
 	int ret;
 	int entry_event_num;
 
-	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
+	if (has_suspend_blocker()) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: abort suspend\n");
 		return;
@@ -310,7 +352,7 @@ static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
-	int ret = has_wake_lock(WAKE_LOCK_SUSPEND) ? -EAGAIN : 0;
+	int ret = has_suspend_blocker() ? -EAGAIN : 0;
 #ifdef CONFIG_WAKELOCK_STAT
 	wait_for_wakeup = 1;
 #endif
@@ -353,8 +395,9 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	INIT_LIST_HEAD(&lock->active_link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -365,6 +408,7 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
+	deactivate_wake_lock(lock);
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
@@ -416,7 +460,7 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 #endif
 	}
-	list_del(&lock->link);
+	trace_wake_lock(lock->name, type, has_timeout ? timeout : -1);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
@@ -424,13 +468,13 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		list_move_tail(&lock->active_link, &timed_wake_locks[type]);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		list_move_tail(&lock->active_link, &untimed_wake_locks[type]);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
@@ -484,9 +528,9 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		trace_wake_unlock(lock->name, type, 0);
+	deactivate_wake_lock(lock);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
 		if (has_lock > 0) {
@@ -538,8 +582,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
+	for (i = 0; i < ARRAY_SIZE(timed_wake_locks); i++) {
+		INIT_LIST_HEAD(&timed_wake_locks[i]);
+		INIT_LIST_HEAD(&untimed_wake_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -257,6 +257,14 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+
+	/* wakeup preemption class and granularity of the group's tasks */
+	unsigned int latency_class;
+	u64 wakeup_gran_ns;
+	/* minimum slack of the timers the group's tasks sleep on */
+	unsigned long timer_slack_ns;
+	/* cpus the group's tasks are placed on at wakeup, if not empty */
+	cpumask_var_t cpu_hint;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -285,6 +293,19 @@ static DEFINE_SPINLOCK(task_group_lock);
 
 # define ROOT_TASK_GROUP_LOAD	NICE_0_LOAD
 
+/*
+ * Wakeup preemption classes. A waking task of a foreground group always
+ * preempts a running task of a background group, and a background task
+ * never preempts a foreground one. Groups inherit the nearest class set
+ * on an ancestor.
+ */
+enum {
+	SCHED_LATENCY_NORMAL,
+	SCHED_LATENCY_FOREGROUND,
+	SCHED_LATENCY_BACKGROUND,
+	SCHED_LATENCY_NR,
+};
+
 /*
  * A weight of 0 or 1 can cause arithmetics problems.
  * A weight of a cfs_rq is the sum of weights of which entities
@@ -466,6 +487,11 @@ struct rq {
 
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
+#ifdef CONFIG_SMP
+	/* decayed load of the queued fair tasks, and busy time of the cpu */
+	unsigned long runnable_load_avg;
+	struct sched_avg avg;
+#endif
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
@@ -1475,9 +1501,176 @@ static int tg_nop(struct task_group *tg, void *data)
 #endif
 
 #ifdef CONFIG_SMP
+/*
+ * Per-entity load tracking.
+ *
+ * The time an entity is runnable is accumulated in 1024us periods, and
+ * older periods are decayed geometrically so that a period contributes
+ * y^n after n periods, with y^32 = 1/2. A task's load contribution is
+ * this average scaled by its weight; rq->runnable_load_avg sums the
+ * contributions of the fair tasks queued on the cpu. rq->avg tracks the
+ * time the cpu was busy in the same way.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* maximum possible runnable_avg_sum */
+#define LOAD_AVG_MAX_N	345	/* periods for the sum to saturate */
+
+/* runnable_avg_yN_inv[n] = y^n * 2^32 */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* runnable_avg_yN_sum[n] = 1024 * (y^1 + y^2 + ... + y^n) */
+static const u32 runnable_avg_yN_sum[] = {
+	    0,  1002,  1982,  2942,  3881,  4800,  5699,  6579,  7440,  8282,
+	 9107,  9914, 10704, 11476, 12232, 12972, 13696, 14405, 15098, 15777,
+	16441, 17091, 17726, 18349, 18957, 19553, 20136, 20707, 21265, 21812,
+	22346, 22870, 23382,
+};
+
+/* returns val * y^n */
+static u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	local_n = n;
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/* returns 1024 * (y^1 + ... + y^n), i.e. n full periods, decayed */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	do {
+		contrib /= 2;
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Accounts the time since the last update as runnable or not. Returns
+ * non-zero when at least one period boundary was crossed.
+ */
+static int __update_runnable_avg(u64 now, struct sched_avg *sa, int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	if (unlikely(!sa->last_runnable_update)) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	delta = now - sa->last_runnable_update;
+	/* the clocks of two cpus can disagree after a migration */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* use 1024ns as the unit of time; ~1us is precise enough */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update = now;
+
+	/* time already accounted in the current, incomplete period */
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* complete the current period, then decay it */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+
+		delta -= delta_w;
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* full periods that elapsed in between */
+		runnable_contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* the remainder opens the next period */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+static inline unsigned long runnable_avg_ratio(struct sched_avg *sa,
+					       unsigned long scale)
+{
+	return div_u64((u64)sa->runnable_avg_sum * scale,
+		       sa->runnable_avg_period + 1);
+}
+
+/*
+ * Brings a fair task's average up to date. When the task is queued on rq,
+ * the change in its contribution is folded into rq->runnable_load_avg.
+ */
+static void update_task_load_avg(struct rq *rq, struct task_struct *p,
+				 int runnable, int queued)
+{
+	struct sched_avg *sa = &p->se.avg;
+	unsigned long contrib;
+
+	__update_runnable_avg(rq->clock_task, sa, runnable);
+
+	contrib = runnable_avg_ratio(sa, p->se.load.weight);
+	if (queued)
+		rq->runnable_load_avg += contrib - sa->load_avg_contrib;
+	sa->load_avg_contrib = contrib;
+}
+
+static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
+{
+	__update_runnable_avg(rq->clock_task, &rq->avg, runnable);
+}
+
 /* Used instead of source_load when we know the type == 0 */
 static unsigned long weighted_cpuload(const int cpu)
 {
+	if (sched_feat(LOAD_AVG))
+		return cpu_rq(cpu)->runnable_load_avg;
 	return cpu_rq(cpu)->load.weight;
 }
 
@@ -2612,6 +2805,14 @@ static void __sched_fork(struct task_struct *p)
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
 
+#ifdef CONFIG_SMP
+	/* new tasks start out looking fully busy until they prove otherwise */
+	p->se.avg.runnable_avg_sum	= 1024;
+	p->se.avg.runnable_avg_period	= 1024;
+	p->se.avg.last_runnable_update	= 0;
+	p->se.avg.load_avg_contrib	= 0;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -3069,6 +3270,75 @@ unsigned long this_cpu_load(void)
 	return this->cpu_load[0];
 }
 
+#ifdef CONFIG_SMP
+/*
+ * These read another cpu's runqueue without its lock; the result is an
+ * estimate, which is all that policy code polling it periodically needs.
+ */
+unsigned long sched_cpu_load_avg(int cpu)
+{
+	return ACCESS_ONCE(cpu_rq(cpu)->runnable_load_avg);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_load_avg);
+
+unsigned long sched_cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	struct sched_avg sa = rq->avg;
+
+	/* an idle cpu's average is only updated when it next wakes up */
+	if (idle_cpu(cpu))
+		__update_runnable_avg(sched_clock_cpu(cpu), &sa, 0);
+
+	return runnable_avg_ratio(&sa, SCHED_LOAD_SCALE);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_util);
+
+unsigned long sched_task_load_avg(struct task_struct *p)
+{
+	return ACCESS_ONCE(p->se.avg.load_avg_contrib);
+}
+EXPORT_SYMBOL_GPL(sched_task_load_avg);
+#else
+unsigned long sched_cpu_load_avg(int cpu)
+{
+	return cpu_rq(cpu)->load.weight;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_load_avg);
+
+unsigned long sched_cpu_util(int cpu)
+{
+	return idle_cpu(cpu) ? 0 : SCHED_LOAD_SCALE;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_util);
+
+unsigned long sched_task_load_avg(struct task_struct *p)
+{
+	return p->se.load.weight;
+}
+EXPORT_SYMBOL_GPL(sched_task_load_avg);
+#endif
+
+/*
+ * The slack of the timers p sleeps on: its own, or that of its cpu
+ * cgroup when larger, so the wakeups of background groups can be
+ * folded into ones that happen anyway.
+ */
+unsigned long task_timer_slack_ns(struct task_struct *p)
+{
+	unsigned long slack = p->timer_slack_ns;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	struct task_group *tg;
+
+	rcu_read_lock();
+	tg = container_of(task_subsys_state(p, cpu_cgroup_subsys_id),
+			  struct task_group, css);
+	slack = max(slack, tg->timer_slack_ns);
+	rcu_read_unlock();
+#endif
+	return slack;
+}
+
 
 /* Variables and functions for calc_load */
 static atomic_long_t calc_load_tasks;
@@ -3397,7 +3667,11 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
  */
 static void update_cpu_load(struct rq *this_rq)
 {
+#ifdef CONFIG_SMP
+	unsigned long this_load = weighted_cpuload(cpu_of(this_rq));
+#else
 	unsigned long this_load = this_rq->load.weight;
+#endif
 	unsigned long curr_jiffies = jiffies;
 	unsigned long pending_updates;
 	int i, scale;
@@ -8472,6 +8746,7 @@ static void free_fair_sched_group(struct task_group *tg)
 
 	kfree(tg->cfs_rq);
 	kfree(tg->se);
+	free_cpumask_var(tg->cpu_hint);
 }
 
 static
@@ -8487,6 +8762,8 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	tg->se = kzalloc(sizeof(se) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->se)
 		goto err;
+	if (!zalloc_cpumask_var(&tg->cpu_hint, GFP_KERNEL))
+		goto err;
 
 	tg->shares = NICE_0_LOAD;
 
@@ -9162,6 +9439,85 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_latency_class_write_u64(struct cgroup *cgrp,
+				       struct cftype *cftype, u64 val)
+{
+	if (val >= SCHED_LATENCY_NR)
+		return -EINVAL;
+	cgroup_tg(cgrp)->latency_class = val;
+	return 0;
+}
+
+static u64 cpu_latency_class_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_class;
+}
+
+static int cpu_wakeup_gran_write_u64(struct cgroup *cgrp,
+				     struct cftype *cftype, u64 val)
+{
+	/* 0 means the global sched_wakeup_granularity_ns */
+	if (val > NSEC_PER_SEC)
+		return -EINVAL;
+	cgroup_tg(cgrp)->wakeup_gran_ns = val;
+	return 0;
+}
+
+static u64 cpu_wakeup_gran_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->wakeup_gran_ns;
+}
+
+static int cpu_timer_slack_write_u64(struct cgroup *cgrp,
+				     struct cftype *cftype, u64 val)
+{
+	if (val > NSEC_PER_SEC)
+		return -EINVAL;
+	cgroup_tg(cgrp)->timer_slack_ns = val;
+	return 0;
+}
+
+static u64 cpu_timer_slack_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->timer_slack_ns;
+}
+
+static int cpu_hint_write(struct cgroup *cgrp, struct cftype *cft,
+			  const char *buf)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	cpumask_var_t new;
+	int ret;
+
+	/* the root group's mask is never allocated */
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (!alloc_cpumask_var(&new, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = cpulist_parse(strstrip((char *)buf), new);
+	if (!ret)
+		cpumask_copy(tg->cpu_hint, new);
+
+	free_cpumask_var(new);
+	return ret;
+}
+
+static int cpu_hint_read(struct cgroup *cgrp, struct cftype *cft,
+			 struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	char buf[64];
+
+	if (tg == &root_task_group)
+		buf[0] = '\0';
+	else
+		cpulist_scnprintf(buf, sizeof(buf), tg->cpu_hint);
+	seq_printf(m, "%s\n", buf);
+	return 0;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -9195,6 +9551,27 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_class",
+		.read_u64 = cpu_latency_class_read_u64,
+		.write_u64 = cpu_latency_class_write_u64,
+	},
+	{
+		.name = "wakeup_granularity_ns",
+		.read_u64 = cpu_wakeup_gran_read_u64,
+		.write_u64 = cpu_wakeup_gran_write_u64,
+	},
+	{
+		.name = "timer_slack_ns",
+		.read_u64 = cpu_timer_slack_read_u64,
+		.write_u64 = cpu_timer_slack_write_u64,
+	},
+	{
+		.name = "cpu_hint",
+		.read_seq_string = cpu_hint_read,
+		.write_string = cpu_hint_write,
+		.max_write_len = (100U + 6 * NR_CPUS),
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -235,6 +235,39 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 	}
 }
 
+/* the task group whose tasks se stands for */
+static inline struct task_group *se_task_group(struct sched_entity *se)
+{
+	return entity_is_task(se) ? cfs_rq_of(se)->tg : group_cfs_rq(se)->tg;
+}
+
+static int tg_latency_class(struct task_group *tg)
+{
+	for (; tg; tg = tg->parent) {
+		if (tg->latency_class != SCHED_LATENCY_NORMAL)
+			return tg->latency_class;
+	}
+	return SCHED_LATENCY_NORMAL;
+}
+
+/*
+ * Returns 1 if the waking task p must preempt curr because of their
+ * groups' latency classes, -1 if it must not, and 0 to decide as usual.
+ */
+static int wakeup_preempt_class(struct task_struct *curr, struct task_struct *p)
+{
+	int curr_class = tg_latency_class(task_group(curr));
+	int p_class = tg_latency_class(task_group(p));
+
+	if (p_class == SCHED_LATENCY_FOREGROUND &&
+	    curr_class == SCHED_LATENCY_BACKGROUND)
+		return 1;
+	if (p_class == SCHED_LATENCY_BACKGROUND &&
+	    curr_class == SCHED_LATENCY_FOREGROUND)
+		return -1;
+	return 0;
+}
+
 #else	/* !CONFIG_FAIR_GROUP_SCHED */
 
 static inline struct task_struct *task_of(struct sched_entity *se)
@@ -1326,6 +1359,12 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+#ifdef CONFIG_SMP
+	/* a waking task was asleep; a migrating one was waiting to run */
+	update_task_load_avg(rq, p, !(flags & ENQUEUE_WAKEUP), 0);
+	rq->runnable_load_avg += se->avg.load_avg_contrib;
+#endif
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1354,6 +1393,12 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+#ifdef CONFIG_SMP
+	update_task_load_avg(rq, p, 1, 1);
+	rq->runnable_load_avg -= min(rq->runnable_load_avg,
+				     se->avg.load_avg_contrib);
+#endif
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -1371,11 +1416,48 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_cfs_shares(cfs_rq);
 	}
 
+#ifdef CONFIG_SMP
+	/* don't let rounding accumulate once the last fair task has left */
+	if (!rq->cfs.nr_running)
+		rq->runnable_load_avg = 0;
+#endif
+
 	hrtick_update(rq);
 }
 
 #ifdef CONFIG_SMP
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Tasks of a group with a cpu hint are placed on an allowed cpu of the
+ * hint: an idle one if possible, else the least loaded. This lets
+ * background groups be packed onto few cores so the others can be
+ * powered down. Returns -1 when the hint doesn't apply.
+ */
+static int select_hint_cpu(struct task_struct *p)
+{
+	struct task_group *tg = task_group(p);
+	unsigned long load, min_load = ULONG_MAX;
+	int i, best = -1;
+
+	if (tg == &root_task_group || cpumask_empty(tg->cpu_hint))
+		return -1;
+
+	for_each_cpu_and(i, tg->cpu_hint, &p->cpus_allowed) {
+		if (!cpu_active(i))
+			continue;
+		if (idle_cpu(i))
+			return i;
+		load = weighted_cpuload(i);
+		if (load < min_load) {
+			min_load = load;
+			best = i;
+		}
+	}
+	return best;
+}
+#endif
+
 static void task_waking_fair(struct rq *rq, struct task_struct *p)
 {
 	struct sched_entity *se = &p->se;
@@ -1607,6 +1689,9 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	int cpu = smp_processor_id();
 	int prev_cpu = task_cpu(p);
 	struct sched_domain *sd;
+	unsigned long least_util = ULONG_MAX;
+	int least_busy = -1;
+	bool found_idle = false;
 	int i;
 
 	/*
@@ -1625,18 +1710,31 @@ static int select_idle_sibling(struct task_struct *p, int target)
 
 	/*
 	 * Otherwise, iterate the domains and find an elegible idle cpu.
+	 * Failing that, remember the sibling that was least busy recently.
 	 */
 	for_each_domain(target, sd) {
 		if (!(sd->flags & SD_SHARE_PKG_RESOURCES))
 			break;
 
 		for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
+			unsigned long util;
+
 			if (idle_cpu(i)) {
 				target = i;
+				found_idle = true;
 				break;
 			}
+
+			util = cpu_rq(i)->avg.runnable_avg_sum;
+			if (util < least_util) {
+				least_util = util;
+				least_busy = i;
+			}
 		}
 
+		if (found_idle)
+			break;
+
 		/*
 		 * Lets stop looking for an idle sibling when we reached
 		 * the domain that spans the current cpu and prev_cpu.
@@ -1646,6 +1744,14 @@ static int select_idle_sibling(struct task_struct *p, int target)
 			break;
 	}
 
+	/*
+	 * No sibling is idle right now: go to one that has been noticeably
+	 * less busy than the target, as it is the more likely to idle soon.
+	 */
+	if (!found_idle && least_busy >= 0 && sched_feat(LOAD_AVG) &&
+	    least_util + LOAD_AVG_MAX / 4 < cpu_rq(target)->avg.runnable_avg_sum)
+		target = least_busy;
+
 	return target;
 }
 
@@ -1671,6 +1777,15 @@ select_task_rq_fair(struct rq *rq, struct task_struct *p, int sd_flag, int wake_
 	int want_sd = 1;
 	int sync = wake_flags & WF_SYNC;
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = select_hint_cpu(p);
+		if (new_cpu >= 0)
+			return new_cpu;
+		new_cpu = cpu;
+	}
+#endif
+
 	if (sd_flag & SD_BALANCE_WAKE) {
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
@@ -1780,6 +1895,11 @@ wakeup_gran(struct sched_entity *curr, struct sched_entity *se)
 {
 	unsigned long gran = sysctl_sched_wakeup_granularity;
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	if (se_task_group(se)->wakeup_gran_ns)
+		gran = se_task_group(se)->wakeup_gran_ns;
+#endif
+
 	/*
 	 * Since its curr running now, convert the gran from real-time
 	 * to virtual-time in his units.
@@ -1887,6 +2007,22 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (unlikely(p->policy != SCHED_NORMAL))
 		return;
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	switch (wakeup_preempt_class(curr, p)) {
+	case 1:
+		/*
+		 * The foreground task has to run next: make it the next
+		 * buddy at every level, and don't let the background one
+		 * come back as the last buddy.
+		 */
+		set_next_buddy(pse);
+		__clear_buddies_last(se);
+		resched_task(curr);
+		return;
+	case -1:
+		return;
+	}
+#endif
 
 	if (!sched_feat(WAKEUP_PREEMPT))
 		return;
@@ -4073,6 +4209,11 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+#ifdef CONFIG_SMP
+	update_task_load_avg(rq, curr, 1, 1);
+	update_rq_runnable_avg(rq, 1);
+#endif
 }
 
 /*
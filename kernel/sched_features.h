@@ -64,3 +64,9 @@ SCHED_FEAT(OWNER_SPIN, 1)
  * Decrement CPU power based on irq activity
  */
 SCHED_FEAT(NONIRQ_POWER, 1)
+
+/*
+ * Balance on the decayed per-entity load average rather than on the
+ * instantaneous runqueue weight
+ */
+SCHED_FEAT(LOAD_AVG, 1)
@@ -31,6 +31,11 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * Events marked D come from deferrable timers, which never wake an idle
+ * cpu. Events marked C are hrtimers which expired early within their
+ * slack, on an interrupt that was due anyway; the others cost a wakeup
+ * of their own.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -156,7 +161,8 @@ static int match_entries(struct entry *entry1, struct entry *entry2)
 	return entry1->timer       == entry2->timer	  &&
 	       entry1->start_func  == entry2->start_func  &&
 	       entry1->expire_func == entry2->expire_func &&
-	       entry1->pid	   == entry2->pid;
+	       entry1->pid	   == entry2->pid &&
+	       entry1->timer_flag  == entry2->timer_flag;
 }
 
 /*
@@ -282,7 +288,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	struct timespec period;
 	struct entry *entry;
 	unsigned long ms;
-	long events = 0;
+	long events = 0, deferred = 0, coalesced = 0;
 	ktime_t time;
 	int i;
 
@@ -309,6 +315,11 @@ static int tstats_show(struct seq_file *m, void *v)
  		if (entry->timer_flag & TIMER_STATS_FLAG_DEFERRABLE) {
 			seq_printf(m, "%4luD, %5d %-16s ",
 				entry->count, entry->pid, entry->comm);
+			deferred += entry->count;
+		} else if (entry->timer_flag & TIMER_STATS_FLAG_COALESCED) {
+			seq_printf(m, "%4luC, %5d %-16s ",
+				entry->count, entry->pid, entry->comm);
+			coalesced += entry->count;
 		} else {
 			seq_printf(m, " %4lu, %5d %-16s ",
 				entry->count, entry->pid, entry->comm);
@@ -332,6 +343,8 @@ static int tstats_show(struct seq_file *m, void *v)
 			   (events * 1000000 / ms) % 1000);
 	else
 		seq_printf(m, "%ld total events\n", events);
+	seq_printf(m, "%ld deferrable, %ld coalesced, %ld own wakeups\n",
+		   deferred, coalesced, events - deferred - coalesced);
 
 	mutex_unlock(&show_mutex);
 
@@ -1435,7 +1435,7 @@ static void process_timeout(unsigned long __data)
 signed long __sched schedule_timeout(signed long timeout)
 {
 	struct timer_list timer;
-	unsigned long expire;
+	unsigned long expire, slack;
 
 	switch (timeout)
 	{
@@ -1469,7 +1469,18 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	/*
+	 * Tasks with a slack of a tick or more, typically from a background
+	 * cgroup, may be woken late to share a wakeup with other timers:
+	 */
+	slack = task_timer_slack_ns(current);
+	if (slack >= TICK_NSEC && !rt_task(current)) {
+		set_timer_slack(&timer, slack / TICK_NSEC);
+		__mod_timer(&timer, apply_slack(&timer, expire), false,
+			    TIMER_NOT_PINNED);
+	} else {
+		__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	}
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
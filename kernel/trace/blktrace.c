@@ -739,6 +739,17 @@ static void blk_add_trace_rq_issue(void *ignore,
 	blk_add_trace_rq(q, rq, BLK_TA_ISSUE);
 }
 
+/*
+ * The hardware start of a request is logged as driver data without a
+ * payload, so that existing tools can parse the trace.
+ */
+static void blk_add_trace_rq_hw_start(void *ignore,
+				      struct request_queue *q,
+				      struct request *rq)
+{
+	blk_add_trace_rq(q, rq, BLK_TA_DRV_DATA);
+}
+
 static void blk_add_trace_rq_requeue(void *ignore,
 				     struct request_queue *q,
 				     struct request *rq)
@@ -987,6 +998,8 @@ static void blk_register_tracepoints(void)
 	WARN_ON(ret);
 	ret = register_trace_block_rq_issue(blk_add_trace_rq_issue, NULL);
 	WARN_ON(ret);
+	ret = register_trace_block_rq_hw_start(blk_add_trace_rq_hw_start, NULL);
+	WARN_ON(ret);
 	ret = register_trace_block_rq_requeue(blk_add_trace_rq_requeue, NULL);
 	WARN_ON(ret);
 	ret = register_trace_block_rq_complete(blk_add_trace_rq_complete, NULL);
@@ -1033,6 +1046,7 @@ static void blk_unregister_tracepoints(void)
 	unregister_trace_block_bio_bounce(blk_add_trace_bio_bounce, NULL);
 	unregister_trace_block_rq_complete(blk_add_trace_rq_complete, NULL);
 	unregister_trace_block_rq_requeue(blk_add_trace_rq_requeue, NULL);
+	unregister_trace_block_rq_hw_start(blk_add_trace_rq_hw_start, NULL);
 	unregister_trace_block_rq_issue(blk_add_trace_rq_issue, NULL);
 	unregister_trace_block_rq_insert(blk_add_trace_rq_insert, NULL);
 	unregister_trace_block_rq_abort(blk_add_trace_rq_abort, NULL);
@@ -1342,6 +1356,7 @@ static const struct {
 	[__BLK_TA_SPLIT]	= {{  "X", "split" },	   blk_log_split },
 	[__BLK_TA_BOUNCE]	= {{  "B", "bounce" },	   blk_log_generic },
 	[__BLK_TA_REMAP]	= {{  "A", "remap" },	   blk_log_remap },
+	[__BLK_TA_DRV_DATA]	= {{ "DD", "drv_data" },  blk_log_generic },
 };
 
 static enum print_line_t print_one_line(struct trace_iterator *iter,
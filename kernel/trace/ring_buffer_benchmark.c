@@ -7,7 +7,9 @@
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/wait.h>
 #include <asm/local.h>
 
 struct rb_page {
@@ -17,8 +19,37 @@ struct rb_page {
 };
 
 /* run time and sleep time in seconds */
-#define RUN_TIME	10
-#define SLEEP_TIME	10
+static int run_time = 10;
+static int sleep_time = 10;
+module_param(run_time, uint, 0644);
+MODULE_PARM_DESC(run_time, "seconds the writers run each interval");
+module_param(sleep_time, uint, 0644);
+MODULE_PARM_DESC(sleep_time, "seconds to sleep between intervals");
+
+/*
+ * Each writer is bound to its own cpu and hammers that cpu's buffer.
+ * The producer thread starts them together and reports on each.
+ */
+struct rb_writer {
+	struct task_struct	*task;
+	int			cpu;
+	int			go;
+	struct completion	done;
+	unsigned long		hit;
+	unsigned long		missed;
+	unsigned long long	time;	/* usecs */
+};
+
+static int event_size = 10;
+module_param(event_size, uint, 0444);
+MODULE_PARM_DESC(event_size, "bytes of data in each event");
+
+static int nr_writers = 1;
+module_param(nr_writers, uint, 0444);
+MODULE_PARM_DESC(nr_writers, "# of writer threads, each on its own cpu (default 1)");
+
+static struct rb_writer *writers;
+static DECLARE_WAIT_QUEUE_HEAD(writer_wait);
 
 /* number of events for writer to wake up the reader */
 static int wakeup_interval = 100;
@@ -211,23 +242,15 @@ static void ring_buffer_consumer(void)
 	complete(&read_done);
 }
 
-static void ring_buffer_producer(void)
+static void ring_buffer_write(struct rb_writer *w)
 {
 	struct timeval start_tv;
 	struct timeval end_tv;
-	unsigned long long time;
-	unsigned long long entries;
-	unsigned long long overruns;
-	unsigned long missed = 0;
-	unsigned long hit = 0;
-	unsigned long avg;
 	int cnt = 0;
 
-	/*
-	 * Hammer the buffer for 10 secs (this may
-	 * make the system stall)
-	 */
-	trace_printk("Starting ring buffer hammer\n");
+	w->hit = 0;
+	w->missed = 0;
+
 	do_gettimeofday(&start_tv);
 	do {
 		struct ring_buffer_event *event;
@@ -235,11 +258,11 @@ static void ring_buffer_producer(void)
 		int i;
 
 		for (i = 0; i < write_iteration; i++) {
-			event = ring_buffer_lock_reserve(buffer, 10);
+			event = ring_buffer_lock_reserve(buffer, event_size);
 			if (!event) {
-				missed++;
+				w->missed++;
 			} else {
-				hit++;
+				w->hit++;
 				entry = ring_buffer_event_data(event);
 				*entry = smp_processor_id();
 				ring_buffer_unlock_commit(buffer, event);
@@ -265,7 +288,41 @@ static void ring_buffer_producer(void)
 			cond_resched();
 #endif
 
-	} while (end_tv.tv_sec < (start_tv.tv_sec + RUN_TIME) && !kill_test);
+	} while (end_tv.tv_sec < (start_tv.tv_sec + run_time) && !kill_test);
+
+	w->time = end_tv.tv_sec - start_tv.tv_sec;
+	w->time *= USEC_PER_SEC;
+	w->time += (long long)((long)end_tv.tv_usec - (long)start_tv.tv_usec);
+}
+
+static void ring_buffer_producer(void)
+{
+	struct timeval start_tv;
+	struct timeval end_tv;
+	unsigned long long time;
+	unsigned long long entries;
+	unsigned long long overruns;
+	unsigned long missed = 0;
+	unsigned long hit = 0;
+	unsigned long avg;
+	int i;
+
+	/*
+	 * Hammer the buffer for 10 secs (this may
+	 * make the system stall)
+	 */
+	trace_printk("Starting ring buffer hammer\n");
+	do_gettimeofday(&start_tv);
+	for (i = 0; i < nr_writers; i++) {
+		init_completion(&writers[i].done);
+		writers[i].go = 1;
+	}
+	/* the completions must be visible before the go flags */
+	smp_wmb();
+	wake_up_all(&writer_wait);
+	for (i = 0; i < nr_writers; i++)
+		wait_for_completion(&writers[i].done);
+	do_gettimeofday(&end_tv);
 	trace_printk("End ring buffer hammer\n");
 
 	if (consumer) {
@@ -311,6 +368,20 @@ static void ring_buffer_producer(void)
 	    producer_nice == 19 && consumer_nice == 19)
 		trace_printk("WARNING!!! This test is running at lowest priority.\n");
 
+	trace_printk("Writers:  %d, event size %d\n", nr_writers, event_size);
+	for (i = 0; i < nr_writers; i++) {
+		struct rb_writer *w = &writers[i];
+		unsigned long long ns = w->time * NSEC_PER_USEC;
+
+		hit += w->hit;
+		missed += w->missed;
+
+		if (w->hit + w->missed)
+			do_div(ns, w->hit + w->missed);
+		trace_printk("CPU %d:    hit %ld missed %ld, %lld ns per entry\n",
+			     w->cpu, w->hit, w->missed, ns);
+	}
+
 	trace_printk("Time:     %lld (usecs)\n", time);
 	trace_printk("Overruns: %lld\n", overruns);
 	if (disable_reader)
@@ -389,6 +460,46 @@ static int ring_buffer_consumer_thread(void *arg)
 	return 0;
 }
 
+static int ring_buffer_writer_thread(void *arg)
+{
+	struct rb_writer *w = arg;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(writer_wait,
+					 w->go || kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		w->go = 0;
+
+		ring_buffer_write(w);
+
+		complete(&w->done);
+	}
+
+	return 0;
+}
+
+static void set_producer_prio(struct task_struct *p)
+{
+	if (producer_fifo >= 0) {
+		struct sched_param param = {
+			.sched_priority = producer_fifo
+		};
+		sched_setscheduler(p, SCHED_FIFO, &param);
+	} else
+		set_user_nice(p, producer_nice);
+}
+
+static void stop_writers(void)
+{
+	int i;
+
+	for (i = 0; i < nr_writers; i++)
+		if (writers[i].task)
+			kthread_stop(writers[i].task);
+	kfree(writers);
+}
+
 static int ring_buffer_producer_thread(void *arg)
 {
 	init_completion(&read_start);
@@ -404,9 +515,9 @@ static int ring_buffer_producer_thread(void *arg)
 
 		ring_buffer_producer();
 
-		trace_printk("Sleeping for 10 secs\n");
+		trace_printk("Sleeping for %d secs\n", sleep_time);
 		set_current_state(TASK_INTERRUPTIBLE);
-		schedule_timeout(HZ * SLEEP_TIME);
+		schedule_timeout(HZ * sleep_time);
 		__set_current_state(TASK_RUNNING);
 	}
 
@@ -419,18 +530,55 @@ static int ring_buffer_producer_thread(void *arg)
 static int __init ring_buffer_benchmark_init(void)
 {
 	int ret;
+	int cpu;
+	int i;
+
+	if (event_size > PAGE_SIZE / 2)
+		return -EINVAL;
+	/* each event carries the id of the cpu that wrote it */
+	if (event_size < sizeof(int))
+		event_size = sizeof(int);
+	if (nr_writers < 1)
+		nr_writers = 1;
+	if (nr_writers > num_online_cpus())
+		nr_writers = num_online_cpus();
 
 	/* make a one meg buffer in overwite mode */
 	buffer = ring_buffer_alloc(1000000, RB_FL_OVERWRITE);
 	if (!buffer)
 		return -ENOMEM;
 
+	writers = kcalloc(nr_writers, sizeof(*writers), GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!writers)
+		goto out_fail;
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		struct rb_writer *w = &writers[i];
+		struct task_struct *task;
+
+		if (i == nr_writers)
+			break;
+		task = kthread_create(ring_buffer_writer_thread, w,
+				      "rb_writer/%d", cpu);
+		ret = PTR_ERR(task);
+		if (IS_ERR(task))
+			goto out_writers;
+		kthread_bind(task, cpu);
+		set_producer_prio(task);
+		w->task = task;
+		w->cpu = cpu;
+		wake_up_process(task);
+		i++;
+	}
+
 	if (!disable_reader) {
 		consumer = kthread_create(ring_buffer_consumer_thread,
 					  NULL, "rb_consumer");
 		ret = PTR_ERR(consumer);
 		if (IS_ERR(consumer))
-			goto out_fail;
+			goto out_writers;
 	}
 
 	producer = kthread_run(ring_buffer_producer_thread,
@@ -453,13 +601,7 @@ static int __init ring_buffer_benchmark_init(void)
 			set_user_nice(consumer, consumer_nice);
 	}
 
-	if (producer_fifo >= 0) {
-		struct sched_param param = {
-			.sched_priority = consumer_fifo
-		};
-		sched_setscheduler(producer, SCHED_FIFO, &param);
-	} else
-		set_user_nice(producer, producer_nice);
+	set_producer_prio(producer);
 
 	return 0;
 
@@ -467,6 +609,9 @@ static int __init ring_buffer_benchmark_init(void)
 	if (consumer)
 		kthread_stop(consumer);
 
+ out_writers:
+	stop_writers();
+
  out_fail:
 	ring_buffer_free(buffer);
 	return ret;
@@ -477,6 +622,7 @@ static void __exit ring_buffer_benchmark_exit(void)
 	kthread_stop(producer);
 	if (consumer)
 		kthread_stop(consumer);
+	stop_writers();
 	ring_buffer_free(buffer);
 }
 
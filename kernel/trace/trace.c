@@ -716,6 +716,93 @@ update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 }
 #endif /* CONFIG_TRACER_MAX_TRACE */
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+/*
+ * The snapshot buffer is the max_tr buffer, grown to the size of the
+ * trace buffer when the snapshot file is first written. Taking a snapshot
+ * swaps the two buffers, which freezes what has been traced so far while
+ * tracing goes on in the other one. snapshot_readers counts the open
+ * readers of both the trace and the snapshot file, whose iterators must
+ * not have their buffer swapped or resized under them. snapshot_allocated
+ * is protected by trace_types_lock; snapshot_armed and snapshot_readers
+ * are also protected by ftrace_max_lock, which is held for the swap.
+ */
+static bool snapshot_allocated;
+static bool snapshot_armed;
+static int snapshot_readers;
+
+/**
+ * tracing_snapshot - freeze the trace recorded so far
+ *
+ * Swaps the trace buffer with the snapshot buffer if the snapshot has been
+ * armed through the snapshot file, and disarms it so that a later trigger
+ * does not replace the snapshot before it has been read. Tracing is not
+ * stopped. Nothing is taken while tracing is stopped or either file is
+ * being read. Safe to call from any context.
+ */
+void tracing_snapshot(void)
+{
+	struct ring_buffer *buf;
+	unsigned long flags;
+
+	if (!snapshot_armed || trace_stop_count)
+		return;
+
+	local_irq_save(flags);
+	arch_spin_lock(&ftrace_max_lock);
+	if (snapshot_armed && !snapshot_readers) {
+		buf = global_trace.buffer;
+		global_trace.buffer = max_tr.buffer;
+		max_tr.buffer = buf;
+		snapshot_armed = false;
+	}
+	arch_spin_unlock(&ftrace_max_lock);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(tracing_snapshot);
+
+static void snapshot_set_armed(bool armed)
+{
+	local_irq_disable();
+	arch_spin_lock(&ftrace_max_lock);
+	snapshot_armed = armed;
+	arch_spin_unlock(&ftrace_max_lock);
+	local_irq_enable();
+}
+
+static void snapshot_readers_add(int n)
+{
+	local_irq_disable();
+	arch_spin_lock(&ftrace_max_lock);
+	snapshot_readers += n;
+	arch_spin_unlock(&ftrace_max_lock);
+	local_irq_enable();
+}
+
+static inline void snapshot_get_reader(void)
+{
+	snapshot_readers_add(1);
+}
+
+static inline void snapshot_put_reader(void)
+{
+	snapshot_readers_add(-1);
+}
+
+static inline bool max_tr_in_use(void)
+{
+	return current_trace->use_max_tr || snapshot_allocated;
+}
+#else
+static inline void snapshot_get_reader(void) { }
+static inline void snapshot_put_reader(void) { }
+
+static inline bool max_tr_in_use(void)
+{
+	return current_trace->use_max_tr;
+}
+#endif /* CONFIG_TRACER_SNAPSHOT */
+
 /**
  * register_tracer - register a tracer with the ftrace system.
  * @type - the plugin for the tracer
@@ -2112,7 +2199,7 @@ static const struct seq_operations tracer_seq_ops = {
 };
 
 static struct trace_iterator *
-__tracing_open(struct inode *inode, struct file *file)
+__tracing_open(struct inode *inode, struct file *file, bool snapshot)
 {
 	long cpu_file = (long) inode->i_private;
 	void *fail_ret = ERR_PTR(-ENOMEM);
@@ -2142,7 +2229,7 @@ __tracing_open(struct inode *inode, struct file *file)
 	if (!zalloc_cpumask_var(&iter->started, GFP_KERNEL))
 		goto fail;
 
-	if (current_trace && current_trace->print_max)
+	if (snapshot || (current_trace && current_trace->print_max))
 		iter->tr = &max_tr;
 	else
 		iter->tr = &global_trace;
@@ -2158,8 +2245,16 @@ __tracing_open(struct inode *inode, struct file *file)
 	if (ring_buffer_overruns(iter->tr->buffer))
 		iter->iter_flags |= TRACE_FILE_ANNOTATE;
 
-	/* stop the trace while dumping */
-	tracing_stop();
+	/*
+	 * stop the trace while dumping, unless this is the snapshot, which
+	 * only needs to be kept from being swapped out; neither buffer may
+	 * be swapped while it is read
+	 */
+	snapshot_get_reader();
+	if (snapshot)
+		iter->iter_flags |= TRACE_FILE_SNAPSHOT;
+	else
+		tracing_stop();
 
 	if (iter->cpu_file == TRACE_PIPE_ALL_CPU) {
 		for_each_tracing_cpu(cpu) {
@@ -2199,7 +2294,9 @@ __tracing_open(struct inode *inode, struct file *file)
 			ring_buffer_read_finish(iter->buffer_iter[cpu]);
 	}
 	free_cpumask_var(iter->started);
-	tracing_start();
+	snapshot_put_reader();
+	if (!snapshot)
+		tracing_start();
  fail:
 	mutex_unlock(&trace_types_lock);
 	kfree(iter->trace);
@@ -2238,7 +2335,9 @@ static int tracing_release(struct inode *inode, struct file *file)
 		iter->trace->close(iter);
 
 	/* reenable tracing if it was previously enabled */
-	tracing_start();
+	snapshot_put_reader();
+	if (!(iter->iter_flags & TRACE_FILE_SNAPSHOT))
+		tracing_start();
 	mutex_unlock(&trace_types_lock);
 
 	seq_release(inode, file);
@@ -2266,7 +2365,7 @@ static int tracing_open(struct inode *inode, struct file *file)
 	}
 
 	if (file->f_mode & FMODE_READ) {
-		iter = __tracing_open(inode, file);
+		iter = __tracing_open(inode, file, false);
 		if (IS_ERR(iter))
 			ret = PTR_ERR(iter);
 		else if (trace_flags & TRACE_ITER_LATENCY_FMT)
@@ -2359,6 +2458,107 @@ static const struct file_operations tracing_fops = {
 	.release	= tracing_release,
 };
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+static int tracing_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct trace_iterator *iter;
+	int ret = 0;
+
+	if (file->f_mode & FMODE_READ) {
+		iter = __tracing_open(inode, file, true);
+		if (IS_ERR(iter))
+			ret = PTR_ERR(iter);
+		else if (trace_flags & TRACE_ITER_LATENCY_FMT)
+			iter->iter_flags |= TRACE_FILE_LAT_FMT;
+	}
+	return ret;
+}
+
+/*
+ * 0 frees the snapshot buffer, 1 allocates it and takes a snapshot now,
+ * 2 allocates it and arms it so that the next tracing_snapshot() call,
+ * e.g. from an event with its snapshot file set, takes the snapshot.
+ */
+static ssize_t
+tracing_snapshot_write(struct file *filp, const char __user *ubuf,
+		       size_t cnt, loff_t *ppos)
+{
+	unsigned long val;
+	char buf[64];
+	int ret;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(&buf, ubuf, cnt))
+		return -EFAULT;
+
+	buf[cnt] = 0;
+
+	ret = strict_strtoul(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val > 2)
+		return -EINVAL;
+
+	ret = tracing_update_buffers();
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&trace_types_lock);
+
+	/* the latency tracers own the max buffer */
+	if (current_trace->use_max_tr) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (!val) {
+		if (snapshot_readers) {
+			ret = -EBUSY;
+			goto out;
+		}
+		snapshot_set_armed(false);
+		if (snapshot_allocated) {
+			ring_buffer_resize(max_tr.buffer, 1);
+			max_tr.entries = 1;
+			snapshot_allocated = false;
+		}
+		goto out;
+	}
+
+	if (!snapshot_allocated) {
+		ret = ring_buffer_resize(max_tr.buffer, global_trace.entries);
+		if (ret < 0)
+			goto out;
+		max_tr.entries = global_trace.entries;
+		snapshot_allocated = true;
+	}
+
+	snapshot_set_armed(true);
+	if (val == 1)
+		tracing_snapshot();
+	ret = 0;
+ out:
+	mutex_unlock(&trace_types_lock);
+
+	if (ret < 0)
+		return ret;
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations snapshot_fops = {
+	.open		= tracing_snapshot_open,
+	.read		= seq_read,
+	.write		= tracing_snapshot_write,
+	.llseek		= tracing_seek,
+	.release	= tracing_release,
+};
+#endif /* CONFIG_TRACER_SNAPSHOT */
+
 static const struct file_operations show_traces_fops = {
 	.open		= show_traces_open,
 	.read		= seq_read,
@@ -2781,7 +2981,7 @@ static int tracing_resize_ring_buffer(unsigned long size)
 	if (ret < 0)
 		return ret;
 
-	if (!current_trace->use_max_tr)
+	if (!max_tr_in_use())
 		goto out;
 
 	ret = ring_buffer_resize(max_tr.buffer, size);
@@ -2876,6 +3076,18 @@ static int tracing_set_tracer(const char *buf)
 	if (t == current_trace)
 		goto out;
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+	/* a tracer which uses the max buffer takes it over */
+	if (t->use_max_tr && snapshot_allocated) {
+		if (snapshot_readers) {
+			ret = -EBUSY;
+			goto out;
+		}
+		snapshot_set_armed(false);
+		snapshot_allocated = false;
+	}
+#endif
+
 	trace_branch_disable();
 	if (current_trace && current_trace->reset)
 		current_trace->reset(tr);
@@ -4365,6 +4577,11 @@ static __init int tracer_init_debugfs(void)
 	trace_create_file("trace_clock", 0644, d_tracer, NULL,
 			  &trace_clock_fops);
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+	trace_create_file("snapshot", 0644, d_tracer,
+			  (void *) TRACE_PIPE_ALL_CPU, &snapshot_fops);
+#endif
+
 #ifdef CONFIG_DYNAMIC_FTRACE
 	trace_create_file("dyn_ftrace_total_info", 0444, d_tracer,
 			&ftrace_update_tot_cnt, &tracing_dyn_info_fops);
@@ -942,6 +942,75 @@ static const struct file_operations ftrace_enable_fops = {
 	.llseek = default_llseek,
 };
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+static ssize_t
+event_snapshot_read(struct file *filp, char __user *ubuf, size_t cnt,
+		    loff_t *ppos)
+{
+	struct ftrace_event_call *call = filp->private_data;
+	char *buf;
+
+	if (call->flags & TRACE_EVENT_FL_SNAPSHOT)
+		buf = "1\n";
+	else
+		buf = "0\n";
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, 2);
+}
+
+/*
+ * When set, every hit of the event that passes its filter calls
+ * tracing_snapshot(), so the filter is the snapshot condition.
+ */
+static ssize_t
+event_snapshot_write(struct file *filp, const char __user *ubuf, size_t cnt,
+		     loff_t *ppos)
+{
+	struct ftrace_event_call *call = filp->private_data;
+	char buf[64];
+	unsigned long val;
+	int ret;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(&buf, ubuf, cnt))
+		return -EFAULT;
+
+	buf[cnt] = 0;
+
+	ret = strict_strtoul(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	switch (val) {
+	case 0:
+	case 1:
+		mutex_lock(&event_mutex);
+		if (val)
+			call->flags |= TRACE_EVENT_FL_SNAPSHOT;
+		else
+			call->flags &= ~TRACE_EVENT_FL_SNAPSHOT;
+		mutex_unlock(&event_mutex);
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations ftrace_event_snapshot_fops = {
+	.open = tracing_open_generic,
+	.read = event_snapshot_read,
+	.write = event_snapshot_write,
+	.llseek = default_llseek,
+};
+#endif
+
 static const struct file_operations ftrace_event_format_fops = {
 	.open = trace_format_open,
 	.read = seq_read,
@@ -1097,6 +1166,13 @@ event_create_dir(struct ftrace_event_call *call, struct dentry *d_events,
 		trace_create_file("enable", 0644, call->dir, call,
 				  enable);
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+	/* only the probes generated by TRACE_EVENT() check the flag */
+	if (call->class->reg == ftrace_event_reg)
+		trace_create_file("snapshot", 0644, call->dir, call,
+				  &ftrace_event_snapshot_fops);
+#endif
+
 #ifdef CONFIG_PERF_EVENTS
 	if (call->event.type && call->class->reg)
 		trace_create_file("id", 0444, call->dir, call,
@@ -41,6 +41,9 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -184,6 +187,13 @@ struct cpu_workqueue_struct {
 	int			nr_active;	/* L: nr of active works */
 	int			max_active;	/* L: max active works */
 	struct list_head	delayed_works;	/* L: delayed works */
+#ifdef CONFIG_WORKQUEUE_STATS
+	u64			nr_executed;	/* L: works executed */
+	u64			wait_ns;	/* L: total queued to start */
+	u64			max_wait_ns;	/* L: longest queued to start */
+	u64			exec_ns;	/* L: total execution time */
+	u64			max_exec_ns;	/* L: longest execution time */
+#endif
 };
 
 /*
@@ -252,11 +262,119 @@ struct workqueue_struct *system_long_wq __read_mostly;
 struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
+struct workqueue_struct *system_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
+EXPORT_SYMBOL_GPL(system_power_efficient_wq);
+
+/*
+ * Works of WQ_POWER_EFFICIENT workqueues are moved to these cpus when
+ * queued elsewhere, so periodic housekeeping doesn't wake up the cpus
+ * that cost the most to keep out of idle.  Empty means no preference.
+ * Updates are serialised by the seqlock, which lets queueing read the
+ * mask without taking a lock.
+ */
+static struct cpumask wq_power_efficient_cpus;
+static DEFINE_SEQLOCK(wq_power_efficient_lock);
+/* set when the mask was given with workqueue.power_efficient_cpus */
+static bool wq_power_efficient_cpus_param;
+
+static void wq_update_power_efficient_cpus(const struct cpumask *mask)
+{
+	unsigned long flags;
+
+	write_seqlock_irqsave(&wq_power_efficient_lock, flags);
+	cpumask_copy(&wq_power_efficient_cpus, mask);
+	write_sequnlock_irqrestore(&wq_power_efficient_lock, flags);
+}
+
+/**
+ * workqueue_set_power_efficient_cpus - set the cpus preferred by
+ * WQ_POWER_EFFICIENT workqueues
+ * @mask: the cpus, or an empty mask for no preference
+ *
+ * Meant for platform defaults: does nothing once the cpus have been
+ * set with the workqueue.power_efficient_cpus parameter.
+ */
+void workqueue_set_power_efficient_cpus(const struct cpumask *mask)
+{
+	if (!wq_power_efficient_cpus_param)
+		wq_update_power_efficient_cpus(mask);
+}
+EXPORT_SYMBOL_GPL(workqueue_set_power_efficient_cpus);
+
+static int wq_power_efficient_cpus_set(const char *val,
+				       const struct kernel_param *kp)
+{
+	cpumask_var_t new;
+	int ret;
+
+	if (!alloc_cpumask_var(&new, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = cpulist_parse(strstrip((char *)val), new);
+	if (!ret) {
+		wq_power_efficient_cpus_param = true;
+		wq_update_power_efficient_cpus(new);
+	}
+
+	free_cpumask_var(new);
+	return ret;
+}
+
+static int wq_power_efficient_cpus_get(char *buf,
+				       const struct kernel_param *kp)
+{
+	unsigned seq;
+	int len;
+
+	do {
+		seq = read_seqbegin(&wq_power_efficient_lock);
+		len = cpulist_scnprintf(buf, PAGE_SIZE - 1,
+					&wq_power_efficient_cpus);
+	} while (read_seqretry(&wq_power_efficient_lock, seq));
+
+	buf[len++] = '\n';
+	buf[len] = '\0';
+	return len;
+}
+
+static struct kernel_param_ops wq_power_efficient_cpus_ops = {
+	.set = wq_power_efficient_cpus_set,
+	.get = wq_power_efficient_cpus_get,
+};
+module_param_cb(power_efficient_cpus, &wq_power_efficient_cpus_ops,
+		NULL, 0644);
+
+/*
+ * Returns the cpu a work queued on @cpu should run on.  The returned cpu
+ * may be going down; its gcwq then handles the work like any other work
+ * of a disassociated gcwq.
+ */
+static unsigned int wq_select_cpu(struct workqueue_struct *wq,
+				  unsigned int cpu)
+{
+	unsigned int target;
+	unsigned seq;
+
+	if (likely(!(wq->flags & WQ_POWER_EFFICIENT)))
+		return cpu;
+
+	do {
+		seq = read_seqbegin(&wq_power_efficient_lock);
+		if (cpumask_empty(&wq_power_efficient_cpus) ||
+		    cpumask_test_cpu(cpu, &wq_power_efficient_cpus))
+			target = cpu;
+		else
+			target = cpumask_any_and(&wq_power_efficient_cpus,
+						 cpu_online_mask);
+	} while (read_seqretry(&wq_power_efficient_lock, seq));
+
+	return target < nr_cpu_ids ? target : cpu;
+}
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -926,6 +1044,9 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+#ifdef CONFIG_WORKQUEUE_STATS
+	work->queued_ns = local_clock();
+#endif
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1000,6 +1121,7 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 
 		if (unlikely(cpu == WORK_CPU_UNBOUND))
 			cpu = raw_smp_processor_id();
+		cpu = wq_select_cpu(wq, cpu);
 
 		/*
 		 * It's multi cpu.  If @wq is non-reentrant and @work
@@ -1169,10 +1291,15 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		timer->data = (unsigned long)dwork;
 		timer->function = delayed_work_timer_fn;
 
-		if (unlikely(cpu >= 0))
+		if (unlikely(cpu >= 0)) {
 			add_timer_on(timer, cpu);
-		else
+		} else if (wq->flags & WQ_POWER_EFFICIENT) {
+			/* expire where the work is going to run */
+			add_timer_on(timer, wq_select_cpu(wq, get_cpu()));
+			put_cpu();
+		} else {
 			add_timer(timer);
+		}
 		ret = 1;
 	}
 	return ret;
@@ -1804,6 +1931,9 @@ __acquires(&gcwq->lock)
 	work_func_t f = work->func;
 	int work_color;
 	struct worker *collision;
+#ifdef CONFIG_WORKQUEUE_STATS
+	u64 start_ns;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -1837,6 +1967,17 @@ __acquires(&gcwq->lock)
 	set_work_cpu(work, gcwq->cpu);
 	list_del_init(&work->entry);
 
+#ifdef CONFIG_WORKQUEUE_STATS
+	start_ns = local_clock();
+	if (start_ns > work->queued_ns) {
+		u64 wait = start_ns - work->queued_ns;
+
+		cwq->wait_ns += wait;
+		if (wait > cwq->max_wait_ns)
+			cwq->max_wait_ns = wait;
+	}
+#endif
+
 	/*
 	 * If HIGHPRI_PENDING, check the next work, and, if HIGHPRI,
 	 * wake up another worker; otherwise, clear HIGHPRI_PENDING.
@@ -1886,6 +2027,17 @@ __acquires(&gcwq->lock)
 
 	spin_lock_irq(&gcwq->lock);
 
+#ifdef CONFIG_WORKQUEUE_STATS
+	{
+		u64 exec = local_clock() - start_ns;
+
+		cwq->nr_executed++;
+		cwq->exec_ns += exec;
+		if (exec > cwq->max_exec_ns)
+			cwq->max_exec_ns = exec;
+	}
+#endif
+
 	/* clear cpu intensive status */
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
@@ -3791,10 +3943,77 @@ static int __init init_workqueues(void)
 	system_nrt_wq = alloc_workqueue("events_nrt", WQ_NON_REENTRANT, 0);
 	system_unbound_wq = alloc_workqueue("events_unbound", WQ_UNBOUND,
 					    WQ_UNBOUND_MAX_ACTIVE);
+	system_power_efficient_wq = alloc_workqueue("events_power_efficient",
+						    WQ_POWER_EFFICIENT, 0);
 	system_freezable_wq = alloc_workqueue("events_freezable",
 					      WQ_FREEZABLE, 0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
-	       !system_unbound_wq || !system_freezable_wq);
+	       !system_unbound_wq || !system_freezable_wq ||
+	       !system_power_efficient_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_WORKQUEUE_STATS
+static int wq_stats_show(struct seq_file *s, void *unused)
+{
+	struct workqueue_struct *wq;
+
+	seq_printf(s, "%-24s %10s %12s %12s %12s %12s\n", "name", "executed",
+		   "avg_wait_us", "max_wait_us", "avg_exec_us", "max_exec_us");
+
+	spin_lock(&workqueue_lock);
+
+	list_for_each_entry(wq, &workqueues, list) {
+		u64 nr = 0, wait = 0, max_wait = 0, exec = 0, max_exec = 0;
+		unsigned int cpu;
+
+		for_each_cwq_cpu(cpu, wq) {
+			struct global_cwq *gcwq = get_gcwq(cpu);
+			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+
+			spin_lock_irq(&gcwq->lock);
+			nr += cwq->nr_executed;
+			wait += cwq->wait_ns;
+			max_wait = max(max_wait, cwq->max_wait_ns);
+			exec += cwq->exec_ns;
+			max_exec = max(max_exec, cwq->max_exec_ns);
+			spin_unlock_irq(&gcwq->lock);
+		}
+
+		if (nr) {
+			wait = div64_u64(wait, nr);
+			exec = div64_u64(exec, nr);
+		}
+		seq_printf(s, "%-24s %10llu %12llu %12llu %12llu %12llu\n",
+			   wq->name, nr,
+			   div_u64(wait, NSEC_PER_USEC),
+			   div_u64(max_wait, NSEC_PER_USEC),
+			   div_u64(exec, NSEC_PER_USEC),
+			   div_u64(max_exec, NSEC_PER_USEC));
+	}
+
+	spin_unlock(&workqueue_lock);
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_show, inode->i_private);
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	debugfs_create_file("workqueue_stats", S_IRUGO, NULL, NULL,
+			    &wq_stats_fops);
+	return 0;
+}
+late_initcall(wq_stats_init);
+#endif
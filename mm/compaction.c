@@ -14,6 +14,11 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,8 +47,60 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	/*
+	 * Optional PFN window to compact within. When end_pfn is zero the
+	 * whole zone is scanned.
+	 */
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+};
+
+/*
+ * Per-order outcome of compaction attempts, both direct and background.
+ * These are only statistics so they are not protected against races.
+ */
+struct compact_order_stat {
+	unsigned long stall;		/* direct compaction attempts */
+	unsigned long success;		/* allocation succeeded after compaction */
+	unsigned long fail;		/* allocation failed after compaction */
+	unsigned long deferred;		/* attempt skipped due to deferral */
+	unsigned long background;	/* kcompactd runs for this order */
+	unsigned long background_success; /* kcompactd met the watermark */
 };
 
+static struct compact_order_stat compact_order_stats[MAX_ORDER];
+
+void compaction_account(int order, enum compact_event event)
+{
+	struct compact_order_stat *stat;
+
+	if (order < 0 || order >= MAX_ORDER)
+		return;
+
+	stat = &compact_order_stats[order];
+	switch (event) {
+	case COMPACT_EV_STALL:
+		stat->stall++;
+		break;
+	case COMPACT_EV_SUCCESS:
+		stat->success++;
+		break;
+	case COMPACT_EV_FAIL:
+		stat->fail++;
+		break;
+	case COMPACT_EV_DEFERRED:
+		stat->deferred++;
+		break;
+	case COMPACT_EV_BACKGROUND:
+		stat->background++;
+		break;
+	case COMPACT_EV_BACKGROUND_SUCCESS:
+		stat->background_success++;
+		break;
+	}
+}
+
 static unsigned long release_freepages(struct list_head *freelist)
 {
 	struct page *page, *next;
@@ -123,8 +180,8 @@ static bool suitable_migration_target(struct page *page)
 	if (PageBuddy(page) && page_order(page) >= pageblock_order)
 		return true;
 
-	/* If the block is MIGRATE_MOVABLE, allow migration */
-	if (migratetype == MIGRATE_MOVABLE)
+	/* If the block is MIGRATE_MOVABLE or MIGRATE_CMA, allow migration */
+	if (migratetype == MIGRATE_MOVABLE || is_migrate_cma(migratetype))
 		return true;
 
 	/* Otherwise skip the block */
@@ -336,7 +393,8 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 		 */
 		pageblock_nr = low_pfn >> pageblock_order;
 		if (!cc->sync && last_pageblock_nr != pageblock_nr &&
-				get_pageblock_migratetype(page) != MIGRATE_MOVABLE) {
+				get_pageblock_migratetype(page) != MIGRATE_MOVABLE &&
+				!is_migrate_cma(get_pageblock_migratetype(page))) {
 			low_pfn += pageblock_nr_pages;
 			low_pfn = ALIGN(low_pfn, pageblock_nr_pages) - 1;
 			last_pageblock_nr = pageblock_nr;
@@ -533,9 +591,15 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		;
 	}
 
-	/* Setup to move all movable pages to the end of the zone */
-	cc->migrate_pfn = zone->zone_start_pfn;
-	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
+	/* Setup to move all movable pages to the end of the zone or window */
+	if (cc->end_pfn) {
+		cc->migrate_pfn = max(cc->start_pfn, zone->zone_start_pfn);
+		cc->free_pfn = min(cc->end_pfn,
+				zone->zone_start_pfn + zone->spanned_pages);
+	} else {
+		cc->migrate_pfn = zone->zone_start_pfn;
+		cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
+	}
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
 	migrate_prep_local();
@@ -602,6 +666,44 @@ unsigned long compact_zone_order(struct zone *zone,
 	return compact_zone(zone, &cc);
 }
 
+/**
+ * compact_zone_range - Compact a PFN window within a zone
+ * @zone: The zone containing the window
+ * @start_pfn: First PFN of the window
+ * @end_pfn: PFN after the last PFN of the window
+ * @sync: Whether migration is synchronous or not
+ *
+ * Movable pages within the window are migrated towards its end so that
+ * free pages coalesce at its start. This is used to defragment regions
+ * that are reserved for large contiguous allocations but lent to the page
+ * allocator for movable pages in the meantime.
+ */
+unsigned long compact_zone_range(struct zone *zone, unsigned long start_pfn,
+				 unsigned long end_pfn, bool sync)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = -1,
+		.migratetype = MIGRATE_MOVABLE,
+		.zone = zone,
+		.sync = sync,
+		.start_pfn = start_pfn,
+		.end_pfn = end_pfn,
+	};
+
+	if (end_pfn <= start_pfn)
+		return COMPACT_SKIPPED;
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	lru_add_drain_all();
+
+	return compact_zone(zone, &cc);
+}
+EXPORT_SYMBOL_GPL(compact_zone_range);
+
 int sysctl_extfrag_threshold = 500;
 
 /**
@@ -634,6 +736,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		return rc;
 
 	count_vm_event(COMPACTSTALL);
+	compaction_account(order, COMPACT_EV_STALL);
 
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
@@ -722,6 +825,227 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Background compaction. kcompactd is woken by the page allocator when a
+ * high-order allocation enters the slow path and compacts the node
+ * asynchronously if the fragmentation index says failures are due to
+ * fragmentation rather than a lack of free memory.
+ */
+int sysctl_compact_background = 1;
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order,
+				    enum zone_type classzone_idx)
+{
+	int zoneid;
+	struct zone *zone;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid;
+	struct zone *zone;
+	int order = pgdat->kcompactd_max_order;
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+
+	compaction_account(order, COMPACT_EV_BACKGROUND);
+
+	/* Flush pending updates to the LRU lists */
+	lru_add_drain_all();
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.sync = false,
+		};
+		int status;
+
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone)) {
+			compaction_account(order, COMPACT_EV_DEFERRED);
+			continue;
+		}
+
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone),
+				      0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			compaction_account(order, COMPACT_EV_BACKGROUND_SUCCESS);
+		} else if (status == COMPACT_COMPLETE) {
+			/* Scanned the whole zone and still failed, back off */
+			defer_compaction(zone);
+		}
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+/*
+ * Wake kcompactd for a high-order allocation of @order that failed in a
+ * zone up to @classzone_idx. The request is dropped if no zone would
+ * benefit from compaction.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order,
+		      enum zone_type classzone_idx)
+{
+	if (!order || !sysctl_compact_background || !pgdat->kcompactd)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx < classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order, classzone_idx))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     kcompactd_work_requested(pgdat));
+		if (kthread_should_stop())
+			break;
+
+		kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int compact_order_stats_show(struct seq_file *m, void *unused)
+{
+	int order;
+
+	seq_printf(m, "%5s %10s %10s %10s %10s %10s %10s\n", "order",
+		   "stall", "success", "fail", "deferred",
+		   "bg_runs", "bg_success");
+	for (order = 1; order < MAX_ORDER; order++) {
+		struct compact_order_stat *stat = &compact_order_stats[order];
+
+		seq_printf(m, "%5d %10lu %10lu %10lu %10lu %10lu %10lu\n",
+			   order, stat->stall, stat->success, stat->fail,
+			   stat->deferred, stat->background,
+			   stat->background_success);
+	}
+
+	return 0;
+}
+
+static int compact_order_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, compact_order_stats_show, NULL);
+}
+
+static const struct file_operations compact_order_stats_fops = {
+	.open		= compact_order_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init compaction_debugfs_init(void)
+{
+	debugfs_create_file("compact_order_stats", S_IRUGO, NULL, NULL,
+			    &compact_order_stats_fops);
+}
+#else
+static inline void compaction_debugfs_init(void)
+{
+}
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+
+	compaction_debugfs_init();
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -0,0 +1,221 @@
+/*
+ *
+ * sched-wakeup.c
+ *
+ * wakeup: Wakeup latency of a foreground task, with and without
+ *         background load
+ *
+ * Two foreground tasks ping-pong a timestamp over a pipe, and the
+ * receiver measures how long it took to be woken up and run. The test
+ * is run once on an idle system and once while CPU hogs are running.
+ * The foreground pair and the hogs can be placed in different cpu
+ * cgroups (e.g. Android's /dev/cpuctl and /dev/cpuctl/bg_non_interactive)
+ * to compare group scheduling settings.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define LOOPS_DEFAULT 10000
+static int loops = LOOPS_DEFAULT;
+static int nr_hogs = 4;
+static const char *fg_cgroup;
+static const char *bg_cgroup;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of wakeups to measure"),
+	OPT_INTEGER('n', "hogs", &nr_hogs,
+		    "Specify number of background CPU hogs"),
+	OPT_STRING('f', "fg-cgroup", &fg_cgroup, "dir",
+		   "cpu cgroup directory for the foreground tasks"),
+	OPT_STRING('b', "bg-cgroup", &bg_cgroup, "dir",
+		   "cpu cgroup directory for the background hogs"),
+	OPT_END()
+};
+
+static const char * const bench_sched_wakeup_usage[] = {
+	"perf bench sched wakeup <options>",
+	NULL
+};
+
+struct wakeup_result {
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void join_cgroup(const char *dir, pid_t pid)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	if (!dir)
+		return;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	fprintf(f, "%d\n", pid);
+	fclose(f);
+}
+
+static void run_hogs(pid_t *hogs)
+{
+	int i;
+
+	for (i = 0; i < nr_hogs; i++) {
+		hogs[i] = fork();
+		assert(hogs[i] >= 0);
+		if (!hogs[i]) {
+			for (;;)
+				;
+		}
+		join_cgroup(bg_cgroup, hogs[i]);
+	}
+}
+
+static void stop_hogs(pid_t *hogs)
+{
+	int i;
+
+	for (i = 0; i < nr_hogs; i++) {
+		kill(hogs[i], SIGKILL);
+		waitpid(hogs[i], NULL, 0);
+	}
+}
+
+static struct wakeup_result measure(void)
+{
+	struct wakeup_result res = { 0, 0 };
+	int ping[2], pong[2];
+	unsigned long long stamp;
+	int __used ret, wait_stat;
+	pid_t pid, retpid;
+	int i;
+
+	assert(!pipe(ping));
+	assert(!pipe(pong));
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		for (i = 0; i < loops; i++) {
+			unsigned long long lat;
+
+			ret = read(ping[0], &stamp, sizeof(stamp));
+			lat = now_ns() - stamp;
+			res.total_ns += lat;
+			if (lat > res.max_ns)
+				res.max_ns = lat;
+			ret = write(pong[1], &stamp, sizeof(stamp));
+		}
+		ret = write(pong[1], &res, sizeof(res));
+		exit(0);
+	}
+
+	for (i = 0; i < loops; i++) {
+		/* let the receiver go to sleep before waking it */
+		usleep(100);
+		stamp = now_ns();
+		ret = write(ping[1], &stamp, sizeof(stamp));
+		ret = read(pong[0], &stamp, sizeof(stamp));
+	}
+	ret = read(pong[0], &res, sizeof(res));
+
+	retpid = waitpid(pid, &wait_stat, 0);
+	assert((retpid == pid) && WIFEXITED(wait_stat));
+
+	close(ping[0]);
+	close(ping[1]);
+	close(pong[0]);
+	close(pong[1]);
+	return res;
+}
+
+static void print_result(const char *name, struct wakeup_result *res)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %10.3f usecs avg, %10.3f usecs max\n", name,
+		       (double)res->total_ns / loops / 1000.0,
+		       (double)res->max_ns / 1000.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.3f %.3f\n",
+		       (double)res->total_ns / loops / 1000.0,
+		       (double)res->max_ns / 1000.0);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_sched_wakeup(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	struct wakeup_result idle, loaded;
+	pid_t *hogs;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_wakeup_usage, 0);
+
+	if (loops <= 0 || nr_hogs < 0) {
+		usage_with_options(bench_sched_wakeup_usage, options);
+		exit(1);
+	}
+
+	hogs = calloc(nr_hogs + 1, sizeof(*hogs));
+	assert(hogs);
+
+	/* the measuring tasks are forked from here and inherit the group */
+	join_cgroup(fg_cgroup, getpid());
+
+	idle = measure();
+
+	run_hogs(hogs);
+	loaded = measure();
+	stop_hogs(hogs);
+	free(hogs);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Measured %d wakeups of a foreground task, "
+		       "without and with %d background hogs\n\n",
+		       loops, nr_hogs);
+
+	print_result("No load", &idle);
+	print_result("Background load", &loaded);
+
+	return 0;
+}
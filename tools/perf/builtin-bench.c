@@ -42,6 +42,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "wakeup",
+	  "Foreground wakeup latency with and without background load",
+	  bench_sched_wakeup    },
 	suite_all,
 	{ NULL,
 	  NULL,